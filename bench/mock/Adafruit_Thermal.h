@@ -0,0 +1,63 @@
+#pragma once
+
+/*
+  Host stand-in for Adafruit_Thermal. Mirrors the library's byte output and
+  its micros()-based pacing (timeoutSet/timeoutWait) for the calls the slip
+  code makes. Like the real object before begin(), state starts zeroed.
+*/
+
+#include "Arduino.h"
+
+class Adafruit_Thermal : public Print {
+ public:
+  explicit Adafruit_Thermal(Stream *stream, uint8_t dtr = 255) : stream_(stream) {
+    (void)dtr;
+  }
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  void begin(uint16_t version = 268);
+  void reset();
+  void setTimes(unsigned long printTimeUs, unsigned long feedTimeUs);
+  void setHeatConfig(uint8_t dots = 11, uint8_t time = 120, uint8_t interval = 40);
+
+  void boldOn();
+  void boldOff();
+  void feed(uint8_t lines = 1);
+  void feedRows(uint8_t rows);
+  void printBitmap(int w, int h, const uint8_t *bitmap, bool fromProgMem = true);
+  void sleep();
+  void sleepAfter(uint16_t seconds);
+  void wake();
+
+  void writeBytes(uint8_t a);
+  void writeBytes(uint8_t a, uint8_t b);
+  void writeBytes(uint8_t a, uint8_t b, uint8_t c);
+  void writeBytes(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+
+  void timeoutSet(unsigned long us);
+  void timeoutWait();
+
+  // Virtual time spent in timeoutWait(), i.e. library-side pacing.
+  uint64_t pacedUs() const {
+    return pacedUs_;
+  }
+
+ private:
+  void writePrintMode();
+
+  Stream *stream_;
+  uint16_t firmware_ = 0;
+  uint8_t printMode_ = 0;
+  uint8_t prevByte_ = 0;
+  uint8_t column_ = 0;
+  uint8_t maxColumn_ = 0;
+  uint8_t charHeight_ = 0;
+  uint8_t lineSpacing_ = 0;
+  uint16_t maxChunkHeight_ = 0;
+  unsigned long dotPrintTime_ = 0;
+  unsigned long dotFeedTime_ = 0;
+  uint64_t resumeTime_ = 0;
+  uint64_t pacedUs_ = 0;
+};
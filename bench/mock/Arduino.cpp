@@ -0,0 +1,44 @@
+#include "Arduino.h"
+
+namespace {
+uint64_t clockUs = 0;
+uint64_t delayTotalUs = 0;
+}  // namespace
+
+namespace mock {
+
+uint64_t nowUs() {
+  return clockUs;
+}
+
+void advanceUs(uint64_t us) {
+  clockUs += us;
+}
+
+uint64_t delayedUs() {
+  return delayTotalUs;
+}
+
+}  // namespace mock
+
+unsigned long millis() {
+  return static_cast<unsigned long>(clockUs / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(clockUs);
+}
+
+void delay(uint32_t ms) {
+  clockUs += static_cast<uint64_t>(ms) * 1000;
+  delayTotalUs += static_cast<uint64_t>(ms) * 1000;
+}
+
+void delayMicroseconds(uint32_t us) {
+  clockUs += us;
+  delayTotalUs += us;
+}
+
+long random(long howBig) {
+  return howBig > 0 ? rand() % howBig : 0;
+}
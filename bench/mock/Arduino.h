@@ -0,0 +1,118 @@
+#pragma once
+
+/*
+  Host stand-in for the subset of the Arduino core used by the slip code.
+  Time is virtual: millis()/micros() read a simulated clock that only moves
+  when something waits (delay(), printer pacing, a full UART FIFO), so the
+  bench measures the firmware's pacing rather than the host CPU.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+class String {
+ public:
+  String(const char *s = "") : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(unsigned value) : s_(std::to_string(value)) {}
+
+  unsigned length() const {
+    return s_.size();
+  }
+  const char *c_str() const {
+    return s_.c_str();
+  }
+  char operator[](unsigned i) const {
+    return s_[i];
+  }
+  int lastIndexOf(char c) const {
+    size_t pos = s_.rfind(c);
+    return pos == std::string::npos ? -1 : static_cast<int>(pos);
+  }
+  String substring(unsigned from) const {
+    return String(s_.substr(from));
+  }
+  bool startsWith(const String &prefix) const {
+    return s_.compare(0, prefix.s_.size(), prefix.s_) == 0;
+  }
+  bool operator==(const String &other) const {
+    return s_ == other.s_;
+  }
+  String &operator+=(const String &other) {
+    s_ += other.s_;
+    return *this;
+  }
+  friend String operator+(const String &a, const String &b) {
+    return String(a.s_ + b.s_);
+  }
+  friend String operator+(const String &a, const char *b) {
+    return String(a.s_ + b);
+  }
+
+ private:
+  std::string s_;
+};
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      write(buffer[i]);
+    }
+    return size;
+  }
+  size_t print(const char *s) {
+    return write(reinterpret_cast<const uint8_t *>(s), strlen(s));
+  }
+  size_t print(const String &s) {
+    return print(s.c_str());
+  }
+  size_t println(const char *s) {
+    return print(s) + print("\r\n");
+  }
+  size_t println(const String &s) {
+    return println(s.c_str());
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+      int c = read();
+      if (c < 0) {
+        break;
+      }
+      buffer[count++] = static_cast<uint8_t>(c);
+    }
+    return count;
+  }
+};
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+long random(long howBig);
+
+namespace mock {
+
+uint64_t nowUs();
+// Moves the virtual clock forward without counting it as delay().
+void advanceUs(uint64_t us);
+// Total virtual time spent inside delay()/delayMicroseconds().
+uint64_t delayedUs();
+
+}  // namespace mock
@@ -0,0 +1,111 @@
+#include "LittleFS.h"
+
+MockFS LittleFS;
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!data_) {
+    return 0;
+  }
+  data_->insert(data_->end(), buffer, buffer + size);
+  return size;
+}
+
+int File::available() {
+  return data_ ? static_cast<int>(data_->size() - pos_) : 0;
+}
+
+int File::read() {
+  if (!data_ || pos_ >= data_->size()) {
+    return -1;
+  }
+  return (*data_)[pos_++];
+}
+
+size_t File::size() const {
+  return data_ ? data_->size() : 0;
+}
+
+void File::close() {
+  data_.reset();
+  isDir_ = false;
+}
+
+File File::openNextFile() {
+  File next;
+  if (!isDir_ || children_.empty()) {
+    return next;
+  }
+  std::string path = children_.front();
+  children_.erase(children_.begin());
+  next = LittleFS.open(path.c_str());
+  next.name_ = path.substr(path.rfind('/') + 1);
+  return next;
+}
+
+File MockFS::open(const char *path, const char *mode) {
+  File file;
+  std::string key(path);
+  file.name_ = key.substr(key.rfind('/') + 1);
+  for (const auto &dir : dirs_) {
+    if (dir == key) {
+      file.isDir_ = true;
+      for (const auto &entry : files_) {
+        if (entry.first.compare(0, key.size() + 1, key + "/") == 0) {
+          file.children_.push_back(entry.first);
+        }
+      }
+      return file;
+    }
+  }
+  if (mode[0] == 'w') {
+    files_[key] = std::make_shared<std::vector<uint8_t>>();
+  }
+  auto it = files_.find(key);
+  if (it != files_.end()) {
+    file.data_ = it->second;
+  }
+  return file;
+}
+
+bool MockFS::exists(const char *path) const {
+  std::string key(path);
+  for (const auto &dir : dirs_) {
+    if (dir == key) {
+      return true;
+    }
+  }
+  return files_.count(key) > 0;
+}
+
+bool MockFS::remove(const char *path) {
+  return files_.erase(path) > 0;
+}
+
+bool MockFS::rename(const char *from, const char *to) {
+  auto it = files_.find(from);
+  if (it == files_.end()) {
+    return false;
+  }
+  auto data = it->second;
+  files_.erase(it);
+  files_[to] = data;
+  return true;
+}
+
+bool MockFS::mkdir(const char *path) {
+  dirs_.push_back(path);
+  return true;
+}
+
+size_t MockFS::usedBytes() const {
+  size_t used = 0;
+  for (const auto &entry : files_) {
+    // LittleFS allocates whole 4 KiB blocks.
+    used += (entry.second->size() + 4095) / 4096 * 4096;
+  }
+  return used;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+  In-memory stand-in for LittleFS: flat map of path to bytes, enough for
+  the slip cache (open/read/write, exists, remove, rename, directory scan).
+*/
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Arduino.h"
+
+class File : public Stream {
+ public:
+  File() {}
+
+  explicit operator bool() const {
+    return data_ != nullptr || isDir_;
+  }
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  size_t size() const;
+  void close();
+  bool isDirectory() const {
+    return isDir_;
+  }
+  const char *name() const {
+    return name_.c_str();
+  }
+  File openNextFile();
+
+ private:
+  friend class MockFS;
+  std::shared_ptr<std::vector<uint8_t>> data_;
+  size_t pos_ = 0;
+  bool isDir_ = false;
+  std::string name_;
+  std::vector<std::string> children_;
+};
+
+class MockFS {
+ public:
+  File open(const char *path, const char *mode = "r");
+  File open(const String &path, const char *mode = "r") {
+    return open(path.c_str(), mode);
+  }
+  bool exists(const char *path) const;
+  bool exists(const String &path) const {
+    return exists(path.c_str());
+  }
+  bool remove(const char *path);
+  bool remove(const String &path) {
+    return remove(path.c_str());
+  }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) {
+    return rename(from.c_str(), to.c_str());
+  }
+  bool mkdir(const char *path);
+  size_t usedBytes() const;
+  size_t totalBytes() const {
+    return capacity;
+  }
+
+  size_t capacity = 1408 * 1024;
+
+ private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files_;
+  std::vector<std::string> dirs_;
+};
+
+extern MockFS LittleFS;
@@ -0,0 +1,159 @@
+#include "mock_printer.h"
+
+static const uint8_t kEsc = 27;
+static const uint8_t kGs = 29;
+static const uint8_t kDc2 = 18;
+static const uint8_t kFontRows = 24;
+static const uint8_t kColumns = 32;
+
+size_t MockPrinterLink::write(uint8_t c) {
+  log_.push_back(c);
+  stats_.bytes += 1;
+
+  const uint64_t byteUs = 10ull * 1000000ull / config_.baud;
+  uint64_t now = mock::nowUs();
+  // Block the writer while the TX FIFO is full.
+  uint64_t fifoDrainUs = static_cast<uint64_t>(config_.txFifoBytes) * byteUs;
+  if (wireDoneUs_ > now + fifoDrainUs) {
+    uint64_t wait = wireDoneUs_ - fifoDrainUs - now;
+    stats_.uartBlockedUs += wait;
+    mock::advanceUs(wait);
+    now += wait;
+  }
+  wireDoneUs_ = (wireDoneUs_ > now ? wireDoneUs_ : now) + byteUs;
+  receive(c, wireDoneUs_);
+  return 1;
+}
+
+uint64_t MockPrinterLink::idleAtUs() const {
+  return engineFreeUs_ > wireDoneUs_ ? engineFreeUs_ : wireDoneUs_;
+}
+
+void MockPrinterLink::finishCommand(uint64_t atUs, uint64_t durationUs) {
+  uint64_t start = engineFreeUs_ > atUs ? engineFreeUs_ : atUs;
+  engineFreeUs_ = start + durationUs;
+  if (start > atUs) {
+    pending_.push_back({start, commandBytes_});
+  } else {
+    buffered_ -= commandBytes_;
+  }
+  commandBytes_ = 0;
+  command_.clear();
+}
+
+void MockPrinterLink::printTextLine(uint64_t atUs) {
+  uint64_t spacing = lineSpacing_ > kFontRows ? lineSpacing_ - kFontRows : 0;
+  stats_.dotRowsPrinted += kFontRows;
+  stats_.dotRowsFed += spacing;
+  lineChars_ = 0;
+  finishCommand(atUs, kFontRows * config_.dotPrintUs + spacing * config_.dotFeedUs);
+}
+
+void MockPrinterLink::receive(uint8_t c, uint64_t atUs) {
+  // Bytes the engine has started on have left the input buffer.
+  while (!pending_.empty() && pending_.front().startUs <= atUs) {
+    buffered_ -= pending_.front().bytes;
+    pending_.pop_front();
+  }
+  buffered_ += 1;
+  commandBytes_ += 1;
+  if (buffered_ > stats_.peakBufferedBytes) {
+    stats_.peakBufferedBytes = buffered_;
+  }
+  if (buffered_ > config_.printerBufferBytes) {
+    stats_.overflowBytes += 1;
+  }
+
+  if (bitmapRemaining_ > 0) {
+    if (--bitmapRemaining_ == 0) {
+      stats_.dotRowsPrinted += bitmapRows_;
+      finishCommand(atUs, bitmapRows_ * config_.dotPrintUs);
+    }
+    return;
+  }
+
+  command_.push_back(c);
+  uint8_t lead = command_[0];
+  size_t len = command_.size();
+  if (lead == kEsc || lead == kGs || lead == kDc2) {
+    if (len < 2) {
+      return;
+    }
+    uint8_t op = command_[1];
+    if (lead == kDc2 && op == '*') {
+      if (len < 4) {
+        return;
+      }
+      bitmapRows_ = command_[2];
+      bitmapRemaining_ = static_cast<uint32_t>(command_[2]) * command_[3];
+      if (bitmapRemaining_ == 0) {
+        finishCommand(atUs, 0);
+      }
+      return;
+    }
+    if (lead == kEsc && op == 'd') {
+      if (len < 3) {
+        return;
+      }
+      uint32_t rows = static_cast<uint32_t>(command_[2]) * lineSpacing_;
+      stats_.dotRowsFed += rows;
+      finishCommand(atUs, rows * config_.dotFeedUs);
+      return;
+    }
+    if (lead == kEsc && op == 'J') {
+      if (len < 3) {
+        return;
+      }
+      stats_.dotRowsFed += command_[2];
+      finishCommand(atUs, command_[2] * config_.dotFeedUs);
+      return;
+    }
+    if (lead == kEsc && op == '3') {
+      if (len < 3) {
+        return;
+      }
+      lineSpacing_ = command_[2];
+      finishCommand(atUs, 0);
+      return;
+    }
+    if (lead == kEsc && op == '2') {
+      lineSpacing_ = 30;
+      finishCommand(atUs, 0);
+      return;
+    }
+    // Fixed-length commands without mechanical cost.
+    size_t need = 3;
+    if (lead == kEsc && (op == '@' || op == '2')) {
+      need = 2;
+    } else if (lead == kEsc && op == '7') {
+      need = 5;
+    } else if (lead == kEsc && op == '8') {
+      need = 4;
+    } else if (lead == kEsc && op == 'D') {
+      // Tab stops, NUL terminated.
+      if (c != 0 || len < 3) {
+        return;
+      }
+      need = len;
+    }
+    if (len >= need) {
+      finishCommand(atUs, 0);
+    }
+    return;
+  }
+
+  if (c == '\n') {
+    printTextLine(atUs);
+    return;
+  }
+  if (c >= 0x20 && c != 0xFF) {
+    // Glyph bytes stay buffered until their line is printed.
+    command_.clear();
+    if (++lineChars_ == kColumns) {
+      printTextLine(atUs);
+    }
+    return;
+  }
+  // Wake byte, NUL padding and other single control bytes.
+  finishCommand(atUs, 0);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+  Serial1 + QR204 stand-in. Records every byte the firmware sends and
+  simulates the two things that bound real throughput: the UART (bytes leave
+  at the configured baud, writes block once the TX FIFO is full) and the
+  print engine (text lines, feeds and bitmap rows cost dot-line time, and
+  bytes wait in the printer's input buffer until the engine gets to them).
+*/
+
+#include <deque>
+#include <vector>
+
+#include "Arduino.h"
+
+struct MockPrinterConfig {
+  uint32_t baud = 9600;
+  uint32_t txFifoBytes = 128;
+  uint32_t printerBufferBytes = 4096;
+  // Per dot line; ~50 mm/s at 8 dots/mm for printing, faster for paper feed.
+  uint32_t dotPrintUs = 2500;
+  uint32_t dotFeedUs = 1000;
+};
+
+struct MockPrinterStats {
+  uint64_t bytes = 0;
+  uint64_t dotRowsPrinted = 0;
+  uint64_t dotRowsFed = 0;
+  uint64_t uartBlockedUs = 0;
+  uint32_t peakBufferedBytes = 0;
+  uint64_t overflowBytes = 0;
+};
+
+class MockPrinterLink : public Stream {
+ public:
+  explicit MockPrinterLink(const MockPrinterConfig &config) : config_(config) {}
+
+  size_t write(uint8_t c) override;
+  using Print::write;
+  int available() override {
+    return 0;
+  }
+  int read() override {
+    return -1;
+  }
+
+  // Virtual time at which the print engine will have finished everything
+  // received so far.
+  uint64_t idleAtUs() const;
+
+  const MockPrinterStats &stats() const {
+    return stats_;
+  }
+  void resetStats() {
+    stats_ = MockPrinterStats();
+  }
+  const std::vector<uint8_t> &log() const {
+    return log_;
+  }
+
+ private:
+  void receive(uint8_t c, uint64_t atUs);
+  void finishCommand(uint64_t atUs, uint64_t durationUs);
+  void printTextLine(uint64_t atUs);
+
+  struct PendingCommand {
+    uint64_t startUs;
+    uint32_t bytes;
+  };
+
+  MockPrinterConfig config_;
+  MockPrinterStats stats_;
+  std::vector<uint8_t> log_;
+
+  uint64_t wireDoneUs_ = 0;
+  uint64_t engineFreeUs_ = 0;
+  std::deque<PendingCommand> pending_;
+  uint32_t buffered_ = 0;
+
+  // ESC/POS parser state.
+  std::vector<uint8_t> command_;
+  uint32_t commandBytes_ = 0;
+  uint32_t bitmapRemaining_ = 0;
+  uint32_t bitmapRows_ = 0;
+  uint32_t lineChars_ = 0;
+  uint8_t lineSpacing_ = 30;
+};
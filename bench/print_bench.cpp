@@ -0,0 +1,340 @@
+/*
+  Print pipeline bench
+
+  Runs the firmware's slip code (src/slip.cpp, src/raster.cpp) on the host
+  against a mock Serial1 + QR204 and reports, per slip: bytes sent, time
+  until printRumors() returns, time until the printer is done, and how much
+  of that was delay(), library pacing and a full UART FIFO. Time is
+  simulated, so results are repeatable and independent of the host.
+
+  Build and run from the repository root:
+    pio run -e bench && .pio/build/bench/program [options]
+
+  Options:
+    --rumors <path>     rumor library (default data/rumors.json)
+    --baud <n>          printer baud rate (default 9600)
+    --dot-print-us <n>  print engine time per printed dot line (default 2500)
+    --dot-feed-us <n>   print engine time per fed dot line (default 1000)
+    --buffer <n>        printer input buffer in bytes (default 4096)
+    --dump <path>       write the bytes of the first scenario to a file
+    --verbose           echo the slip code's log lines
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Adafruit_Thermal.h"
+#include "LittleFS.h"
+#include "mock_printer.h"
+#include "slip.h"
+
+namespace {
+
+bool verbose = false;
+
+struct Scenario {
+  const char *name;
+  bool raster;
+  bool warmCache;
+  size_t burst;
+  // Firmware pacing passed to setTimes(); 0/0 keeps begin()'s defaults.
+  unsigned long dotPrintTimeUs;
+  unsigned long dotFeedTimeUs;
+};
+
+// What setup() does today, plus variants worth comparing.
+const Scenario kScenarios[] = {
+    {"text, setTimes(200,200)", false, false, 1, 200, 200},
+    {"raster cold cache", true, false, 1, 200, 200},
+    {"raster warm cache", true, true, 1, 200, 200},
+    {"raster warm, burst of 4", true, true, 4, 200, 200},
+    {"raster warm, library pacing", true, true, 1, 0, 0},
+};
+
+struct Totals {
+  uint64_t slips = 0;
+  uint64_t bytes = 0;
+  uint64_t returnUs = 0;
+  uint64_t wallUs = 0;
+  uint64_t delayUs = 0;
+  uint64_t pacedUs = 0;
+  uint64_t uartUs = 0;
+  uint64_t hostNs = 0;
+  uint32_t peakBuffered = 0;
+  uint64_t overflow = 0;
+};
+
+// Minimal reader for the flat rumor array in data/rumors.json.
+class RumorFileReader {
+ public:
+  explicit RumorFileReader(const std::string &text) : text_(text) {}
+
+  bool read(std::vector<Rumor> &out) {
+    skipSpace();
+    if (!consume('[')) {
+      return false;
+    }
+    skipSpace();
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      Rumor rumor;
+      if (!readObject(rumor)) {
+        return false;
+      }
+      refreshRumorRevision(rumor);
+      out.push_back(rumor);
+      skipSpace();
+    } while (consume(','));
+    return consume(']');
+  }
+
+ private:
+  bool readObject(Rumor &rumor) {
+    skipSpace();
+    if (!consume('{')) {
+      return false;
+    }
+    do {
+      skipSpace();
+      std::string key;
+      if (!readString(key)) {
+        return false;
+      }
+      skipSpace();
+      if (!consume(':')) {
+        return false;
+      }
+      skipSpace();
+      if (pos_ < text_.size() && text_[pos_] == '"') {
+        std::string value;
+        if (!readString(value)) {
+          return false;
+        }
+        if (key == "title") {
+          rumor.title = String(value);
+        } else if (key == "text_nl") {
+          rumor.textNl = String(value);
+        } else if (key == "text_en") {
+          rumor.textEn = String(value);
+        } else if (key == "people") {
+          rumor.people = String(value);
+        }
+      } else {
+        size_t start = pos_;
+        while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}') {
+          ++pos_;
+        }
+        std::string value = text_.substr(start, pos_ - start);
+        if (key == "id") {
+          rumor.id = static_cast<uint32_t>(atol(value.c_str()));
+        } else if (key == "active") {
+          rumor.active = value.compare(0, 4, "true") == 0;
+        }
+      }
+      skipSpace();
+    } while (consume(','));
+    return consume('}');
+  }
+
+  bool readString(std::string &out) {
+    if (!consume('"')) {
+      return false;
+    }
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      char c = text_[pos_++];
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (pos_ >= text_.size()) {
+        return false;
+      }
+      char esc = text_[pos_++];
+      if (esc == 'n') {
+        out += '\n';
+      } else if (esc == 't') {
+        out += '\t';
+      } else if (esc == 'u' && pos_ + 4 <= text_.size()) {
+        unsigned cp = static_cast<unsigned>(strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16));
+        pos_ += 4;
+        if (cp < 0x80) {
+          out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+          out += static_cast<char>(0xC0 | (cp >> 6));
+          out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+          out += static_cast<char>(0xE0 | (cp >> 12));
+          out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+          out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+      } else {
+        out += esc;
+      }
+    }
+    return consume('"');
+  }
+
+  void skipSpace() {
+    while (pos_ < text_.size() && isspace(static_cast<unsigned char>(text_[pos_]))) {
+      ++pos_;
+    }
+  }
+
+  bool consume(char c) {
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  const std::string &text_;
+  size_t pos_ = 0;
+};
+
+bool loadLibrary(const char *path, std::vector<Rumor> &out) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  std::string text;
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    text.append(buffer, n);
+  }
+  fclose(file);
+  return RumorFileReader(text).read(out);
+}
+
+// Lets the printer finish before the next job, as the firmware's status
+// confirmation does.
+void waitForPrinter(const MockPrinterLink &link) {
+  uint64_t idle = link.idleAtUs();
+  if (idle > mock::nowUs()) {
+    mock::advanceUs(idle - mock::nowUs());
+  }
+}
+
+Totals runScenario(const Scenario &scenario, const std::vector<Rumor> &library, const MockPrinterConfig &config,
+                   const char *dumpPath) {
+  MockPrinterLink link(config);
+  Adafruit_Thermal printer(&link);
+  SlipPrinter slips(printer);
+  slips.setRasterSlips(scenario.raster);
+
+  printer.begin();
+  if (scenario.dotPrintTimeUs || scenario.dotFeedTimeUs) {
+    printer.setTimes(scenario.dotPrintTimeUs, scenario.dotFeedTimeUs);
+  }
+  purgeSlipCache(0);
+  if (scenario.warmCache) {
+    for (const auto &rumor : library) {
+      slips.printRumors({rumor});
+    }
+  }
+  waitForPrinter(link);
+
+  Totals totals;
+  link.resetStats();
+  size_t logStart = link.log().size();
+  for (size_t i = 0; i < library.size(); i += scenario.burst) {
+    std::vector<Rumor> batch;
+    for (size_t j = i; j < library.size() && j < i + scenario.burst; ++j) {
+      batch.push_back(library[j]);
+    }
+
+    uint64_t start = mock::nowUs();
+    uint64_t delayedBefore = mock::delayedUs();
+    uint64_t pacedBefore = printer.pacedUs();
+    auto hostStart = std::chrono::steady_clock::now();
+    slips.printRumors(batch);
+    auto hostEnd = std::chrono::steady_clock::now();
+    totals.returnUs += mock::nowUs() - start;
+    totals.wallUs += link.idleAtUs() - start;
+    totals.delayUs += mock::delayedUs() - delayedBefore;
+    totals.pacedUs += printer.pacedUs() - pacedBefore;
+    totals.hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(hostEnd - hostStart).count();
+    totals.slips += batch.size();
+    waitForPrinter(link);
+  }
+  const MockPrinterStats &stats = link.stats();
+  totals.bytes = stats.bytes;
+  totals.uartUs = stats.uartBlockedUs;
+  totals.peakBuffered = stats.peakBufferedBytes;
+  totals.overflow = stats.overflowBytes;
+
+  if (dumpPath) {
+    FILE *dump = fopen(dumpPath, "wb");
+    if (dump) {
+      fwrite(link.log().data() + logStart, 1, link.log().size() - logStart, dump);
+      fclose(dump);
+    }
+  }
+  return totals;
+}
+
+}  // namespace
+
+// The slip code's log lines; quiet unless --verbose.
+void slipLog(const char *message) {
+  if (verbose) {
+    fprintf(stderr, "%s\n", message);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *rumorsPath = "data/rumors.json";
+  const char *dumpPath = nullptr;
+  MockPrinterConfig config;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--rumors" && hasValue) {
+      rumorsPath = argv[++i];
+    } else if (arg == "--baud" && hasValue) {
+      config.baud = static_cast<uint32_t>(atol(argv[++i]));
+    } else if (arg == "--dot-print-us" && hasValue) {
+      config.dotPrintUs = static_cast<uint32_t>(atol(argv[++i]));
+    } else if (arg == "--dot-feed-us" && hasValue) {
+      config.dotFeedUs = static_cast<uint32_t>(atol(argv[++i]));
+    } else if (arg == "--buffer" && hasValue) {
+      config.printerBufferBytes = static_cast<uint32_t>(atol(argv[++i]));
+    } else if (arg == "--dump" && hasValue) {
+      dumpPath = argv[++i];
+    } else if (arg == "--verbose") {
+      verbose = true;
+    } else {
+      fprintf(stderr, "unknown option %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  std::vector<Rumor> library;
+  if (!loadLibrary(rumorsPath, library) || library.empty()) {
+    fprintf(stderr, "could not read rumors from %s\n", rumorsPath);
+    return 1;
+  }
+  slipCacheBegin();
+
+  printf("%zu rumors, %u baud, %u/%u us per printed/fed dot line, %u byte printer buffer\n\n", library.size(),
+         static_cast<unsigned>(config.baud), static_cast<unsigned>(config.dotPrintUs),
+         static_cast<unsigned>(config.dotFeedUs), static_cast<unsigned>(config.printerBufferBytes));
+  printf("%-30s %8s %9s %9s %9s %9s %9s %9s %8s %9s\n", "per slip", "bytes", "return ms", "wall ms", "delay ms",
+         "paced ms", "uart ms", "host us", "peak buf", "overflow");
+  bool first = true;
+  for (const auto &scenario : kScenarios) {
+    Totals t = runScenario(scenario, library, config, first ? dumpPath : nullptr);
+    first = false;
+    double n = static_cast<double>(t.slips);
+    printf("%-30s %8.0f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8u %9llu\n", scenario.name, t.bytes / n,
+           t.returnUs / n / 1000.0, t.wallUs / n / 1000.0, t.delayUs / n / 1000.0, t.pacedUs / n / 1000.0,
+           t.uartUs / n / 1000.0, t.hostNs / n / 1000.0, static_cast<unsigned>(t.peakBuffered),
+           static_cast<unsigned long long>(t.overflow));
+  }
+  return 0;
+}
@@ -2,20 +2,33 @@ const rumorList = document.getElementById("rumorList");
 const rumorCount = document.getElementById("rumorCount");
 const nameFilter = document.getElementById("nameFilter");
 const resetAllBtn = document.getElementById("resetAllBtn");
+const importBtn = document.getElementById("importBtn");
+const importFile = document.getElementById("importFile");
+const activateShownBtn = document.getElementById("activateShownBtn");
+const deactivateShownBtn = document.getElementById("deactivateShownBtn");
 const cancelEditBtn = document.getElementById("cancelEditBtn");
 const formTitle = document.getElementById("formTitle");
+const statusSub = document.getElementById("statusSub");
 
 const form = document.getElementById("rumorForm");
 const titleInput = document.getElementById("titleInput");
 const textNlInput = document.getElementById("textNlInput");
 const textEnInput = document.getElementById("textEnInput");
 const peopleInput = document.getElementById("peopleInput");
+const poolInput = document.getElementById("poolInput");
 const maxPrintsInput = document.getElementById("maxPrintsInput");
 const activeInput = document.getElementById("activeInput");
 
-let rumors = [];
+// Local copy of the whole library, kept current with deltas from
+// /api/rumors/changes. Filtering happens here, not on the server.
+const library = new Map();
+let syncBoot = "";
+let syncVersion = 0;
+let syncing = null;
+let syncAgain = false;
 let editingId = null;
-let filterTimer = null;
+// Per mill: triggers waiting and slips printed, from the event socket.
+const mills = new Map();
 
 function setEditing(rumor) {
   if (!rumor) {
@@ -34,6 +47,7 @@ function setEditing(rumor) {
   textNlInput.value = rumor.text_nl || "";
   textEnInput.value = rumor.text_en || "";
   peopleInput.value = rumor.people || "";
+  poolInput.value = rumor.pool || "";
   maxPrintsInput.value = rumor.max_prints || 5;
   activeInput.checked = !!rumor.active;
 }
@@ -45,7 +59,28 @@ function createTag(text, className) {
   return tag;
 }
 
+// Same rule as the server's name filter: case-insensitive substring of any
+// comma-separated name.
+function matchesName(rumor, needle) {
+  if (!needle) {
+    return true;
+  }
+  return (rumor.people || "")
+    .toLowerCase()
+    .split(",")
+    .some((name) => {
+      const trimmed = name.trim();
+      return trimmed.length > 0 && trimmed.includes(needle);
+    });
+}
+
+function shownRumors() {
+  const needle = nameFilter.value.trim().toLowerCase();
+  return [...library.values()].filter((rumor) => matchesName(rumor, needle));
+}
+
 function renderRumors() {
+  const rumors = shownRumors();
   rumorList.innerHTML = "";
   const activeCount = rumors.filter((r) => r.active).length;
   rumorCount.textContent = `${activeCount}/${rumors.length}`;
@@ -67,6 +102,9 @@ function renderRumors() {
     meta.appendChild(
       createTag(`${rumor.printed_count}/${rumor.max_prints} prints`, "pill")
     );
+    if (rumor.pool) {
+      meta.appendChild(createTag(`Pool: ${rumor.pool}`, "pill"));
+    }
     if (rumor.people) {
       const people = document.createElement("span");
       people.textContent = `People: ${rumor.people}`;
@@ -98,70 +136,179 @@ function renderRumors() {
   });
 }
 
-async function fetchRumors() {
-  const query = nameFilter.value.trim();
-  const url = query ? `/api/rumors?name=${encodeURIComponent(query)}` : "/api/rumors";
-  const response = await fetch(url);
+// The mill turns requests away with 429 and Retry-After while the store is
+// busy or too many changes are in flight. Try again a few times, backing
+// off with jitter so clients turned away together do not come back
+// together; Retry-After caps the wait.
+const kRetryAttempts = 4;
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+async function apiFetch(url, options = {}) {
+  for (let attempt = 1; ; attempt += 1) {
+    const response = await fetch(url, options);
+    if (response.status !== 429 || attempt === kRetryAttempts) {
+      return response;
+    }
+    const retryAfterMs = (Number(response.headers.get("Retry-After")) || 1) * 1000;
+    const backoffMs = Math.min(retryAfterMs, 250 * 2 ** (attempt - 1));
+    await sleep(backoffMs / 2 + (Math.random() * backoffMs) / 2);
+  }
+}
+
+async function reportFailure(action, response) {
+  const result = await response.json().catch(() => ({}));
+  alert(`${action} failed: ${result.error || response.status}`);
+}
+
+async function pullChanges() {
+  const url = `/api/rumors/changes?since=${syncVersion}&boot=${encodeURIComponent(syncBoot)}`;
+  const response = await apiFetch(url, { cache: "no-store" });
   if (!response.ok) {
     return;
   }
-  rumors = await response.json();
+  const delta = await response.json();
+  if (delta.full) {
+    library.clear();
+  }
+  (delta.deleted || []).forEach((id) => library.delete(id));
+  delta.rumors.forEach((rumor) => library.set(rumor.id, rumor));
+  syncBoot = delta.boot;
+  syncVersion = delta.version;
   renderRumors();
 }
 
+// Only one pull at a time; a request that comes in meanwhile is folded into
+// one more pull afterwards.
+async function syncRumors() {
+  if (syncing) {
+    syncAgain = true;
+    return syncing;
+  }
+  syncing = (async () => {
+    do {
+      syncAgain = false;
+      await pullChanges();
+    } while (syncAgain);
+  })();
+  try {
+    await syncing;
+  } finally {
+    syncing = null;
+  }
+}
+
 async function createRumor(payload) {
-  const response = await fetch("/api/rumors", {
+  const response = await apiFetch("/api/rumors", {
     method: "POST",
     headers: { "Content-Type": "application/json" },
     body: JSON.stringify(payload),
   });
-  if (response.ok) {
-    await fetchRumors();
-    setEditing(null);
+  if (!response.ok) {
+    await reportFailure("Saving the rumor", response);
+    return;
   }
+  await syncRumors();
+  setEditing(null);
 }
 
 async function updateRumor(id, payload) {
-  const response = await fetch(`/api/rumors/${id}`, {
+  const response = await apiFetch(`/api/rumors/${id}`, {
     method: "PUT",
     headers: { "Content-Type": "application/json" },
     body: JSON.stringify(payload),
   });
-  if (response.ok) {
-    await fetchRumors();
+  if (!response.ok) {
+    await reportFailure("Saving the rumor", response);
+    return false;
   }
+  await syncRumors();
+  return true;
 }
 
 async function deleteRumor(id) {
-  const response = await fetch(`/api/rumors/${id}`, { method: "DELETE" });
-  if (response.ok) {
-    await fetchRumors();
-    if (editingId === id) {
-      setEditing(null);
-    }
+  const response = await apiFetch(`/api/rumors/${id}`, { method: "DELETE" });
+  if (!response.ok) {
+    await reportFailure("Deleting the rumor", response);
+    return;
+  }
+  await syncRumors();
+  if (editingId === id) {
+    setEditing(null);
   }
 }
 
 async function resetRumor(id) {
-  const response = await fetch(`/api/rumors/${id}/reset`, { method: "POST" });
-  if (response.ok) {
-    await fetchRumors();
+  const response = await apiFetch(`/api/rumors/${id}/reset`, { method: "POST" });
+  if (!response.ok) {
+    await reportFailure("Resetting the count", response);
+    return;
   }
+  await syncRumors();
 }
 
 resetAllBtn.addEventListener("click", async () => {
-  const response = await fetch("/api/rumors/resetAll", { method: "POST" });
+  const response = await apiFetch("/api/rumors/resetAll", { method: "POST" });
+  if (!response.ok) {
+    await reportFailure("Resetting all counts", response);
+    return;
+  }
+  await syncRumors();
+});
+
+// The server takes at most this many operations per PATCH.
+const kMaxBatchOps = 64;
+
+async function setShownActive(active) {
+  const ops = shownRumors()
+    .filter((rumor) => rumor.active !== active)
+    .map((rumor) => ({ op: "update", id: rumor.id, active }));
+  for (let i = 0; i < ops.length; i += kMaxBatchOps) {
+    const response = await apiFetch("/api/rumors", {
+      method: "PATCH",
+      headers: { "Content-Type": "application/json" },
+      body: JSON.stringify(ops.slice(i, i + kMaxBatchOps)),
+    });
+    if (!response.ok) {
+      await reportFailure("Updating the shown rumors", response);
+      break;
+    }
+  }
+  await syncRumors();
+}
+
+activateShownBtn.addEventListener("click", () => setShownActive(true));
+deactivateShownBtn.addEventListener("click", () => setShownActive(false));
+
+importBtn.addEventListener("click", () => importFile.click());
+
+// Adds the rumors from an export file (one JSON object per line) to the
+// library in one request.
+importFile.addEventListener("change", async () => {
+  const file = importFile.files[0];
+  importFile.value = "";
+  if (!file) {
+    return;
+  }
+  const response = await apiFetch("/api/rumors/import", {
+    method: "POST",
+    headers: { "Content-Type": "application/x-ndjson" },
+    body: file,
+  });
   if (response.ok) {
-    await fetchRumors();
+    await syncRumors();
+    return;
   }
+  const result = await response.json().catch(() => ({}));
+  const where = result.line ? ` on line ${result.line}` : "";
+  alert(`Import failed: ${result.error || response.status}${where}`);
 });
 
 cancelEditBtn.addEventListener("click", () => setEditing(null));
 
-nameFilter.addEventListener("input", () => {
-  clearTimeout(filterTimer);
-  filterTimer = setTimeout(fetchRumors, 250);
-});
+nameFilter.addEventListener("input", renderRumors);
 
 form.addEventListener("submit", async (event) => {
   event.preventDefault();
@@ -170,16 +317,59 @@ form.addEventListener("submit", async (event) => {
     text_nl: textNlInput.value.trim(),
     text_en: textEnInput.value.trim(),
     people: peopleInput.value.trim(),
+    pool: poolInput.value.trim(),
     max_prints: Number(maxPrintsInput.value) || 5,
     active: activeInput.checked,
   };
 
   if (editingId) {
-    await updateRumor(editingId, payload);
-    setEditing(null);
+    if (await updateRumor(editingId, payload)) {
+      setEditing(null);
+    }
   } else {
     await createRumor(payload);
   }
 });
 
-fetchRumors();
+function renderMills() {
+  if (mills.size === 0) {
+    statusSub.textContent = "active and ready";
+    return;
+  }
+  statusSub.textContent = [...mills.entries()]
+    .map(([name, mill]) => `${name}: ${mill.printed} printed, ${mill.queued} waiting`)
+    .join(" · ");
+}
+
+function millState(name) {
+  if (!mills.has(name)) {
+    mills.set(name, { printed: 0, queued: 0 });
+  }
+  return mills.get(name);
+}
+
+function handleEvent(event) {
+  if (event.t === "store") {
+    if (event.v !== syncVersion) {
+      syncRumors();
+    }
+  } else if (event.t === "queue") {
+    millState(event.m).queued = event.d;
+    renderMills();
+  } else if (event.t === "print") {
+    millState(event.m).printed = event.printed;
+    renderMills();
+  }
+}
+
+// Store, queue and print events pushed by the mill. Messages can be dropped
+// for a slow phone, so every (re)connect starts with a delta pull.
+function connectEvents() {
+  const socket = new WebSocket(`ws://${location.host}/api/events`);
+  socket.onopen = () => syncRumors();
+  socket.onmessage = (message) => handleEvent(JSON.parse(message.data));
+  socket.onclose = () => setTimeout(connectEvents, 2000);
+}
+
+syncRumors();
+connectEvents();
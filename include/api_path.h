@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  API path matching
+
+  The part of the router that only looks at strings, kept apart from the
+  server so the host tests can run it. See api_router.h.
+*/
+
+static const size_t kApiMaxParams = 2;
+
+struct ApiParams {
+  uint32_t values[kApiMaxParams] = {};
+  uint8_t count = 0;
+
+  uint32_t operator[](size_t index) const {
+    return values[index];
+  }
+};
+
+// True if `path` matches `pattern` exactly. Each {name} segment in the
+// pattern takes a decimal number that fits in a uint32_t, stored in
+// `params` in order.
+bool apiMatchPath(const char *pattern, const char *path, ApiParams &params);
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "api_path.h"
+#include "metrics.h"
+
+/*
+  API router
+
+  One web handler for every /api route, dispatching from a static table
+  instead of a chain of callback handlers with std::regex paths. A request
+  path is walked once against each candidate pattern, character by
+  character; a {name} segment matches a decimal number and reaches the
+  route as a uint32_t, so handlers never parse path strings. Matching is
+  exact ("/api/rumors" does not catch "/api/rumors/7"), so the order of the
+  table does not matter.
+
+  The router also does admission control. Anything but a GET takes one of
+  kApiMaxInFlight slots from its first body byte until the connection
+  closes, which bounds the memory held by uploads. When they are all taken
+  it is turned away at once with 429 and Retry-After rather than queued.
+
+  A route has up to two handlers. The onTcp one runs on the async_tcp task
+  as soon as the request is in and answers whatever needs no lock and no
+  flash: the status, a 304 from the store version. It must never block.
+  Whatever it leaves unanswered goes to onRequest, which once begin() has
+  started the workers is queued to a small pool of worker tasks, so a slow
+  handler (a flash save, a big list) no longer stalls every other
+  connection. A full queue is answered with 429 like a full set of slots.
+
+  ESPAsyncWebServer is not thread-safe, so a worker never touches the
+  AsyncWebServerRequest. The router copies what a handler may read into an
+  ApiRequest when it dispatches, and the handler only builds its response
+  there. The request itself gets a stand-in response on async_tcp, which
+  passes over to the handler's response on the next poll or ack of the
+  connection. lwIP only polls every 500 ms, so a worker that is done asks
+  the tcpip thread to fire the connection's poll callback right away; the
+  response then goes out one round through the tcpip and async_tcp queues
+  after its handler returned.
+
+  A client can go away while its request waits or runs. The ApiRequest is
+  shared between the connection and the worker, and the stand-in response
+  marks it gone when the server deletes the request; a worker never starts
+  on a request that is gone, and whichever side lets go last frees it.
+  Nothing on async_tcp ever waits for a worker.
+
+  Each route counts its requests and times them from dispatch until its
+  last handler returns, queue wait included, for /api/metrics.
+*/
+
+static const size_t kApiMaxInFlight = 2;
+static const size_t kApiQueueDepth = 8;
+
+class ApiRequest;
+
+typedef void (*ApiRequestHandler)(ApiRequest *request, const ApiParams &params);
+typedef bool (*ApiBodyHandler)(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+typedef void (*ApiDoneHandler)(void *body);
+
+struct ApiRoute {
+  WebRequestMethod method;
+  // Literal segments and {name} placeholders, e.g. "/api/rumors/{id}/reset".
+  const char *path;
+  // Runs on async_tcp once the request is in; must not block. The request
+  // goes on to onRequest if this is unset or sends nothing.
+  ApiRequestHandler onTcp;
+  // Runs on a worker: anything that waits on the store lock or flash.
+  ApiRequestHandler onRequest;
+  // Runs on async_tcp for each piece of the body, collecting it in
+  // _tempObject. Returns false once it has answered the request itself
+  // (a 413, say): the rest of the body is dropped and the route's handler
+  // never runs.
+  ApiBodyHandler onBody;
+  // Releases what the body handler left in _tempObject, when a plain free()
+  // cannot, once neither the request nor its handler needs it any more.
+  ApiDoneHandler onDone;
+};
+
+// What a route handler gets of its request: the query parameters and
+// headers, copied on async_tcp, and the body, taken over from _tempObject.
+// The calls mirror AsyncWebServerRequest, but responses are only built
+// here; send() hands one to the router, which sends it on async_tcp.
+class ApiRequest {
+ public:
+  ApiRequest(AsyncWebServerRequest *request, ApiDoneHandler onDone);
+  ~ApiRequest();
+  ApiRequest(const ApiRequest &) = delete;
+  ApiRequest &operator=(const ApiRequest &) = delete;
+
+  WebRequestMethodComposite method() const {
+    return method_;
+  }
+  size_t contentLength() const {
+    return contentLength_;
+  }
+  bool hasParam(const char *name) const;
+  // The value of a query parameter, empty if it is missing.
+  String param(const char *name) const;
+  bool hasHeader(const char *name) const;
+  String header(const char *name) const;
+  // What the route's body handler left in _tempObject, or nullptr.
+  void *body() const {
+    return body_;
+  }
+
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(),
+                                        const String &content = String());
+  AsyncWebServerResponse *beginResponse(const String &contentType, size_t len, AwsResponseFiller callback);
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller callback);
+  AsyncResponseStream *beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+  // The first response sent is the one that goes out; later ones are
+  // dropped.
+  void send(AsyncWebServerResponse *response);
+  void send(int code, const String &contentType = String(), const String &content = String());
+
+  bool responded() const {
+    return response_.load(std::memory_order_acquire) != nullptr;
+  }
+  // The response sent, once; the caller owns it from then on.
+  AsyncWebServerResponse *takeResponse();
+
+  // Set once the server has deleted the request.
+  std::atomic<bool> gone{false};
+
+ private:
+  struct Field {
+    String name;
+    String value;
+  };
+
+  static const Field *findField(const std::vector<Field> &fields, const char *name);
+
+  WebRequestMethodComposite method_;
+  size_t contentLength_;
+  std::vector<Field> params_;
+  std::vector<Field> headers_;
+  void *body_;
+  ApiDoneHandler onDone_;
+  std::atomic<AsyncWebServerResponse *> response_{nullptr};
+};
+
+struct ApiRouteMetrics {
+  std::atomic<uint32_t> requests;
+  MetricHistogram latency;
+};
+
+// 429 with Retry-After, for requests that should try again shortly.
+void apiSendBusy(AsyncWebServerRequest *request);
+void apiSendBusy(ApiRequest *request);
+// How many 429s apiSendBusy() has sent since boot.
+uint32_t apiBusyCount();
+
+const char *apiMethodName(WebRequestMethod method);
+
+// The route for method and path, or nullptr. `pathMatched` is set when some
+// route has the path but not the method.
+const ApiRoute *apiMatch(const ApiRoute *routes, size_t count, WebRequestMethodComposite method, const char *path,
+                         ApiParams &params, bool &pathMatched);
+
+class ApiRouter : public AsyncWebHandler {
+ public:
+  ApiRouter(const ApiRoute *routes, size_t count)
+      : routes_(routes), count_(count), metrics_(new ApiRouteMetrics[count]()) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+  bool isRequestHandlerTrivial() override {
+    return false;
+  }
+
+  // Starts `workers` tasks that run the route handlers. Until then, or if
+  // the tasks cannot be created, handlers run on the async_tcp task.
+  bool begin(uint8_t workers, uint32_t stackBytes, UBaseType_t priority);
+
+  size_t routeCount() const {
+    return count_;
+  }
+  const ApiRoute &route(size_t index) const {
+    return routes_[index];
+  }
+  const ApiRouteMetrics &routeMetrics(size_t index) const {
+    return metrics_[index];
+  }
+  // Time requests spent queued for a worker.
+  const MetricHistogram &queueWait() const {
+    return queueWait_;
+  }
+
+ private:
+  struct Job;
+  // A request this router accepted, from canHandle() until it disconnects.
+  struct Tracked {
+    AsyncWebServerRequest *request;
+    bool holdsSlot;
+    bool rejected;
+  };
+
+  Tracked *find(AsyncWebServerRequest *request);
+  bool admit(Tracked &tracked);
+  void dispatch(AsyncWebServerRequest *request, const ApiRoute &route, const ApiParams &params);
+  void release(AsyncWebServerRequest *request, ApiDoneHandler onDone);
+  void finish(const ApiRoute &route, ApiRequest &request, int64_t dispatchedUs);
+  static void workerTask(void *arg);
+
+  const ApiRoute *routes_;
+  size_t count_;
+  std::unique_ptr<ApiRouteMetrics[]> metrics_;
+  MetricHistogram queueWait_{};
+  QueueHandle_t queue_ = nullptr;
+  // Only touched on the async_tcp task; workers get what they need in the
+  // job they are handed.
+  std::vector<Tracked> tracked_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+  Gzip writer
+
+  A small streaming deflate for API responses: greedy LZ77 over a 4 KB
+  window with hash chains, coded with the fixed Huffman tables (no tree is
+  built or sent). It compresses JSON prose to well under half its size with
+  about 24 KB of state, where a general-purpose deflate wants ten times that
+  for its window and trees. Output is a complete gzip member any browser
+  accepts.
+
+  The state is too big for a task stack; allocate the writer on the heap.
+*/
+
+class GzipWriter {
+ public:
+  // Appends the compressed stream to `out`, which must outlive the writer.
+  explicit GzipWriter(std::vector<uint8_t> &out);
+
+  void write(const uint8_t *data, size_t len);
+  void write(const String &text) {
+    write(reinterpret_cast<const uint8_t *>(text.c_str()), text.length());
+  }
+
+  // Compresses what is left and writes the gzip trailer. Call once.
+  void finish();
+
+ private:
+  static const size_t kWindow = 4096;
+  static const size_t kWindowMask = kWindow - 1;
+  static const size_t kMinMatch = 3;
+  static const size_t kMaxMatch = 258;
+  static const size_t kHashBits = 12;
+  static const size_t kMaxChain = 16;
+
+  void compress(bool flush);
+  void insert(size_t at);
+  void emitLiteral(uint8_t value);
+  void emitMatch(size_t length, size_t distance);
+  void writeSymbol(uint16_t symbol);
+  void writeCode(uint16_t code, uint8_t bits);
+  void writeBits(uint32_t value, uint8_t bits);
+
+  std::vector<uint8_t> &out_;
+  uint32_t crc_ = 0xFFFFFFFF;
+  uint32_t size_ = 0;
+  uint32_t bitBuffer_ = 0;
+  uint8_t bitCount_ = 0;
+  // Stream offset of buf_[0]. Positions in head_/prev_ are stream offsets
+  // cut to 16 bits; stale ones are caught by the distance and byte checks.
+  uint32_t base_ = 0;
+  size_t fill_ = 0;
+  size_t pos_ = 0;
+  uint8_t buf_[2 * kWindow];
+  uint16_t head_[1 << kHashBits];
+  uint16_t prev_[kWindow];
+};
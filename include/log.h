@@ -0,0 +1,128 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string.h>
+#include <type_traits>
+
+/*
+  Event log
+
+  Log lines from the tasks are stored as compact binary records (a
+  timestamp, an event id and up to four arguments) in a lock-free ring. A
+  low-priority task turns them into text for Serial and, if enabled, a
+  rotating file on LittleFS. Logging reads the timer, takes a slot with one
+  atomic increment and fills the record in place; only a String argument
+  is copied. It never waits for the UART, the flash or another task. When
+  the drain task falls a whole ring behind, the oldest records are lost and
+  counted.
+
+  Arguments are kept as they are passed:
+  - Integers are stored as values.
+  - `const char *` is stored as a pointer, so it must stay valid:
+    literals, names in flash, error strings.
+  - One `String` per record can be copied in, cut to kLogTextMax - 1
+    chars, for text that will not outlive the call.
+  Formats are printf-like and use only %u, %d, %x and %s.
+*/
+
+static const size_t kLogCapacity = 64;
+static const size_t kLogMaxArgs = 4;
+static const size_t kLogTextMax = 32;
+
+// Index into the format table in log.cpp; keep the two in step.
+enum LogEvent : uint16_t {
+  kLogText,
+  kLogDropped,
+  kLogRumorParseFailed,
+  kLogRumorsLoaded,
+  kLogRumorsImported,
+  kLogConfigParseFailed,
+  kLogConfigIgnored,
+  kLogConfigApplied,
+  kLogPrintAttemptFailed,
+  kLogPrintNoRumors,
+  kLogPrintRumor,
+  kLogPrintUnconfirmed,
+  kLogPrintGaveUp,
+  kLogPrinterAsleep,
+  kLogTriggersReceived,
+  kLogReedTrigger,
+  kLogReedCooldown,
+  kLogLightSleepUnavailable,
+  kLogLowPower,
+  kLogPrinterReady,
+  kLogApUp,
+  kLogApIp,
+  kLogEventCount,
+};
+
+struct LogRecord {
+  int64_t atUs;
+  uint16_t event;
+  uint8_t argCount;
+  // Index of the argument held in `text`, or kLogNoText.
+  uint8_t textArg;
+  uintptr_t args[kLogMaxArgs];
+  char text[kLogTextMax];
+};
+
+static const uint8_t kLogNoText = 0xFF;
+
+// Starts the drain task; records logged before are kept and printed then.
+void logBegin();
+// Also appends to a file on LittleFS, which must be mounted.
+void logEnableFile();
+// Claims the next slot, stamped with the time, and returns its record to
+// fill in; logPublish() hands it to the drain task. logEvent() is the way
+// in.
+LogRecord &logReserve(uint32_t &seq);
+void logPublish(uint32_t seq);
+
+namespace logdetail {
+
+// Declared up front so each overload can recurse into all the others.
+inline void pack(LogRecord &) {}
+template <typename T, typename... Rest>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type pack(LogRecord &record, T value,
+                                                                                         const Rest &...rest);
+template <typename... Rest>
+void pack(LogRecord &record, const char *text, const Rest &...rest);
+template <typename... Rest>
+void pack(LogRecord &record, const String &text, const Rest &...rest);
+
+template <typename T, typename... Rest>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type pack(LogRecord &record, T value,
+                                                                                         const Rest &...rest) {
+  record.args[record.argCount++] = static_cast<uintptr_t>(value);
+  pack(record, rest...);
+}
+
+template <typename... Rest>
+void pack(LogRecord &record, const char *text, const Rest &...rest) {
+  record.args[record.argCount++] = reinterpret_cast<uintptr_t>(text);
+  pack(record, rest...);
+}
+
+template <typename... Rest>
+void pack(LogRecord &record, const String &text, const Rest &...rest) {
+  record.textArg = record.argCount;
+  strncpy(record.text, text.c_str(), kLogTextMax - 1);
+  record.text[kLogTextMax - 1] = '\0';
+  record.args[record.argCount++] = 0;
+  pack(record, rest...);
+}
+
+}  // namespace logdetail
+
+template <typename... Args>
+void logEvent(LogEvent event, const Args &...args) {
+  static_assert(sizeof...(Args) <= kLogMaxArgs, "too many log arguments");
+  uint32_t seq;
+  LogRecord &record = logReserve(seq);
+  record.event = event;
+  record.argCount = 0;
+  record.textArg = kLogNoText;
+  logdetail::pack(record, args...);
+  logPublish(seq);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+  Metrics
+
+  Counters and fixed-bucket latency histograms for /api/metrics. Recording
+  is a handful of relaxed 32-bit atomic increments, lock-free on both
+  cores, so it stays on in production. A scrape reads the counters one by
+  one, so a histogram's buckets can be a sample or two apart from its
+  count; over a rate window that does not matter.
+
+  Sums are kept in microseconds in 32 bits and wrap after about 71
+  minutes of accumulated time. Prometheus treats a wrap like a counter
+  reset.
+*/
+
+static const size_t kMetricBucketCount = 14;
+
+// Upper bounds of all but the last bucket, in microseconds; the last one
+// catches everything slower.
+extern const uint32_t kMetricBucketsUs[kMetricBucketCount - 1];
+
+struct MetricHistogram {
+  std::atomic<uint32_t> buckets[kMetricBucketCount];
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> sumUs;
+
+  void record(uint32_t us);
+};
+
+// Histogram in Prometheus text format: cumulative _bucket lines with `le`
+// in seconds, then _sum and _count. `labels` is empty or like
+// `mode="shared"`, without braces. Print the # TYPE line once per name
+// before the first series.
+void metricPrometheusHistogram(Print &out, const char *name, const char *labels, const MetricHistogram &histogram);
+
+// {"count":..,"sum_us":..,"buckets":[..]} with per-bucket (not cumulative)
+// counts in kMetricBucketsUs order.
+void metricJsonHistogram(Print &out, const MetricHistogram &histogram);
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+  Raster slips
+
+  Renders a rumor to a 1-bpp bitmap the width of the print head, using a
+  built-in 5x8 font so we are not limited to the printer's own character
+  sets (accented Dutch text, decorative borders). Rows are produced one at a
+  time so a whole slip never has to sit in RAM, and are stored with a small
+  PackBits-style RLE because slips are mostly white.
+*/
+
+static const uint16_t kRasterWidth = 384;
+static const uint16_t kRasterRowBytes = kRasterWidth / 8;
+// Worst case for one encoded row: every 128 literal bytes costs one header.
+static const uint16_t kRasterMaxEncodedRow = kRasterRowBytes + (kRasterRowBytes + 127) / 128;
+
+class RasterSlip {
+ public:
+  // Lays out the slip. Strings are UTF-8; anything outside ASCII and
+  // Latin-1 letters is approximated or replaced with '?'.
+  void layout(const char *title, const char *textNl, const char *textEn);
+
+  uint16_t height() const {
+    return height_;
+  }
+
+  // Fills `row` (kRasterRowBytes) with row y, MSB is the leftmost dot.
+  void renderRow(uint16_t y, uint8_t *row) const;
+
+ private:
+  enum BlockKind : uint8_t { kBlockText, kBlockOrnament, kBlockDivider, kBlockSpace };
+
+  struct Glyph {
+    uint8_t base;
+    uint8_t accent;
+  };
+
+  struct Block {
+    BlockKind kind;
+    uint8_t scale;
+    uint16_t top;
+    uint16_t rows;
+    uint16_t left;
+    std::vector<Glyph> glyphs;
+  };
+
+  void addBlock(BlockKind kind, uint16_t rows);
+  void addParagraph(const char *text, uint8_t scale, bool centered);
+
+  std::vector<Block> blocks_;
+  uint16_t height_ = 0;
+};
+
+// RLE row codec. Each row is encoded independently so a reader can stop at
+// any row boundary and print in bands.
+size_t rasterEncodeRow(const uint8_t *row, uint8_t *out);
+bool rasterDecodeRow(Stream &in, uint8_t *row);
+
+// Cache file header: magic (ending in the format version), then width and
+// height in dots, little endian.
+static const uint8_t kRasterMagic[4] = {'R', 'M', 'S', '1'};
+static const size_t kRasterHeaderSize = 8;
+
+void rasterWriteHeader(Print &out, uint16_t height);
+bool rasterReadHeader(Stream &in, uint16_t &height);
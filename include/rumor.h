@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+
+static const uint16_t kDefaultMaxPrints = 5;
+
+struct Rumor {
+  uint32_t id = 0;
+  String title;
+  String textNl;
+  String textEn;
+  String people;
+  // Mills with a pool set only print rumors from that pool.
+  String pool;
+  bool active = true;
+  uint16_t maxPrints = kDefaultMaxPrints;
+  uint16_t printedCount = 0;
+  // Prints handed to the printer but not yet confirmed. Never persisted.
+  uint16_t reservedCount = 0;
+  // Hash of everything that ends up on the slip; keys the bitmap cache.
+  uint32_t revision = 0;
+  // The rumor as the API and the store file write it, kept current on
+  // every change so listing and saving only copy bytes.
+  String json;
+};
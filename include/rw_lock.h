@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+  Reader-writer lock
+
+  Any number of readers at once, or one writer. Built from a FreeRTOS mutex
+  and a binary semaphore so waits can time out like xSemaphoreTake():
+
+  - The mutex is a turnstile. A reader passes through it only to register
+    itself. A writer keeps it for the whole write, which stops new readers
+    while the current ones drain, so a stream of readers cannot starve a
+    writer.
+  - The last reader out gives the semaphore. A writer holding the turnstile
+    waits on it until the reader count reaches zero.
+
+  Not recursive. A reader must not ask for the write lock, and a writer must
+  not ask for either. Call begin() once before first use, from a task.
+*/
+
+class RwLock {
+ public:
+  bool begin();
+
+  bool lockShared(uint32_t timeoutMs);
+  void unlockShared();
+
+  bool lock(uint32_t timeoutMs);
+  void unlock();
+
+ private:
+  SemaphoreHandle_t turnstile_ = nullptr;
+  SemaphoreHandle_t drained_ = nullptr;
+  std::atomic<uint32_t> readers_{0};
+};
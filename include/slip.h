@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_Thermal.h>
+#include <vector>
+
+#include "raster.h"
+#include "rumor.h"
+
+/*
+  Slip printing
+
+  Everything that turns rumors into bytes for the thermal printer: raster or
+  text slips, the LittleFS bitmap cache and the pacing between commands.
+  Kept free of Wi-Fi and RTOS code so the host bench can drive it against a
+  mock printer.
+*/
+
+static const uint16_t kSlipBandRows = 24;
+
+// Creates the cache directory. Call once LittleFS is mounted.
+void slipCacheBegin();
+
+// Recomputes rumor.revision from the fields that end up on paper.
+void refreshRumorRevision(Rumor &rumor);
+
+// Removes cached slips for one rumor (every revision), or all of them when
+// rumorId is 0.
+void purgeSlipCache(uint32_t rumorId);
+
+// Where the slip code's log lines go. Defined by the firmware (the event
+// log) and by the bench.
+void slipLog(const char *message);
+
+class SlipPrinter {
+ public:
+  // `slot` tells printers sharing the cache apart; give each one its own.
+  explicit SlipPrinter(Adafruit_Thermal &printer, uint8_t slot = 0) : printer_(printer), slot_(slot) {}
+
+  // Bitmap slips (own font, accents, borders) when true, the printer's
+  // built-in font when false (the default). Bitmap slips fall back to text
+  // on failure. At 9600 baud a bitmap slip takes about ten times as long
+  // to send as a text one, cache or not.
+  void setRasterSlips(bool enabled) {
+    rasterSlips_ = enabled;
+  }
+
+  // Prints a burst as one continuous stream: a single lead-in and run-out
+  // feed, with a tear line between slips.
+  void printRumors(const std::vector<Rumor> &batch);
+  void printNoRumors();
+
+ private:
+  void printRumor(const Rumor &rumor);
+  bool printRumorBitmap(const Rumor &rumor);
+  bool printCachedSlip(const char *path);
+  void printRenderedSlip(const RasterSlip &slip);
+  void printSlipBand(uint16_t rows);
+  void printSlipSeparator();
+
+  Adafruit_Thermal &printer_;
+  uint8_t slot_;
+  bool rasterSlips_ = false;
+  uint8_t band_[kSlipBandRows * kRasterRowBytes];
+};
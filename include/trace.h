@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+  Job trace
+
+  A fixed ring of timestamped events along the path from a reed edge to the
+  slip leaving the printer. Recording is lock-free (one atomic increment and
+  a per-slot sequence number) so it can sit on the hot path of every task
+  without adding contention; readers copy a snapshot and throw away slots
+  that were overwritten while they looked.
+*/
+
+static const size_t kTraceCapacity = 256;
+
+// In pipeline order; summaries measure each stage from the previous one
+// seen for the same job.
+enum TraceStage : uint8_t {
+  kTraceReedEdge,
+  kTraceEnqueued,
+  kTraceDequeued,
+  kTraceLockAcquired,
+  kTracePickDone,
+  kTraceFirstByte,
+  kTracePrinted,
+  kTraceSaved,
+  kTraceJobDone,
+  kTraceStageCount,
+};
+
+struct TraceEvent {
+  uint32_t seq;
+  // Low 32 bits of esp_timer_get_time(); differences stay valid for ~71 min.
+  uint32_t atUs;
+  uint16_t job;
+  uint8_t stage;
+  uint8_t mill;
+};
+
+struct TraceSummary {
+  uint32_t count = 0;
+  uint32_t p50Us = 0;
+  uint32_t p90Us = 0;
+  uint32_t p99Us = 0;
+  uint32_t maxUs = 0;
+};
+
+const char *traceStageName(uint8_t stage);
+
+// Ids tie the events of one trigger together.
+uint16_t traceNewJob();
+void traceRecord(TraceStage stage, uint16_t job, uint8_t mill);
+void traceRecordAt(TraceStage stage, uint16_t job, uint8_t mill, int64_t atUs);
+
+// Copies the events still in the ring, oldest first. Returns the count.
+size_t traceSnapshot(TraceEvent *out, size_t max);
+
+// Per stage: time since the previous stage of the same job. `total` is reed
+// edge to job done.
+void traceSummarize(const TraceEvent *events, size_t count, TraceSummary stages[kTraceStageCount],
+                    TraceSummary &total);
@@ -0,0 +1,183 @@
+"""
+Times the web API of a running mill.
+
+    python scripts/api_bench.py batch [--host http://192.168.4.1] [--count 50]
+    python scripts/api_bench.py list [--host http://192.168.4.1] [--count 20]
+    python scripts/api_bench.py contention [--host http://192.168.4.1] [--count 20]
+    python scripts/api_bench.py latency [--host http://192.168.4.1] [--count 20]
+
+batch: imports `count` scratch rumors, toggles them with one PUT each and
+then back with a single PATCH /api/rumors, and deletes them again. Prints
+the latency of each PUT and of the batch.
+
+list: fetches /api/rumors `count` times plain and `count` times with
+Accept-Encoding: gzip. Prints the bytes on the wire and the time to the last
+byte of each. The first gzip fetch after a change also pays for compressing.
+
+contention: fetches the plain /api/rumors list from 1, 4 and 8 clients at
+once, `count` fetches each. Prints the lists per second across all clients,
+the latency of each fetch, and how many were answered 429. The firmware runs
+handlers on kApiWorkers (2) tasks, so at most two lists are built at once:
+lists/s should stop growing past 2 clients, and from there more clients
+only add queueing to the latency (and 429s once the queue of 8 is full).
+
+latency: times `count` requests to routes answered on async_tcp (status, an
+up-to-date changes poll, a list revalidated with If-None-Match) and to the
+plain list, which is built on a worker. A worker wakes the connection when
+its handler is done instead of leaving the response to lwIP's next poll, so
+the two should differ by about the time the list takes to build, not by up
+to 500 ms.
+"""
+
+import argparse
+import json
+import statistics
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+SCRATCH_PERSON = "api-bench"
+
+
+def call(host, method, path, body=None, content_type="application/json"):
+    data = None
+    headers = {}
+    if body is not None:
+        data = body if isinstance(body, bytes) else json.dumps(body).encode("utf-8")
+        headers["Content-Type"] = content_type
+    request = urllib.request.Request(host + path, data=data, method=method, headers=headers)
+    started = time.perf_counter()
+    with urllib.request.urlopen(request, timeout=30) as response:
+        payload = response.read()
+    elapsed_ms = (time.perf_counter() - started) * 1000
+    return elapsed_ms, json.loads(payload) if payload else None
+
+
+def scratch_ids(host):
+    _, rumors = call(host, "GET", "/api/rumors?name=" + urllib.parse.quote(SCRATCH_PERSON))
+    return [rumor["id"] for rumor in rumors]
+
+
+def describe(label, samples):
+    print("%-12s n=%-3d total %7.1f ms  median %6.1f ms  max %6.1f ms" %
+          (label, len(samples), sum(samples), statistics.median(samples), max(samples)))
+
+
+def bench_batch(host, count):
+    lines = []
+    for i in range(count):
+        lines.append(json.dumps({
+            "title": "bench %d" % i, "text_nl": "bench", "text_en": "bench",
+            "people": SCRATCH_PERSON, "active": True,
+        }))
+    call(host, "POST", "/api/rumors/import", "\n".join(lines).encode("utf-8"), "application/x-ndjson")
+    ids = scratch_ids(host)
+    try:
+        singles = [call(host, "PUT", "/api/rumors/%d" % rumor_id, {"active": False})[0] for rumor_id in ids]
+        batch, _ = call(host, "PATCH", "/api/rumors", [{"op": "update", "id": rumor_id, "active": True}
+                                                       for rumor_id in ids])
+        describe("single PUT", singles)
+        describe("batch PATCH", [batch])
+        print("speedup      %.1fx" % (sum(singles) / batch))
+    finally:
+        call(host, "PATCH", "/api/rumors", [{"op": "delete", "id": rumor_id} for rumor_id in ids])
+
+
+def fetch_list(host, gzip):
+    headers = {"Accept-Encoding": "gzip"} if gzip else {}
+    request = urllib.request.Request(host + "/api/rumors", headers=headers)
+    started = time.perf_counter()
+    with urllib.request.urlopen(request, timeout=30) as response:
+        body = response.read()
+        encoding = response.headers.get("Content-Encoding", "identity")
+    return (time.perf_counter() - started) * 1000, len(body), encoding
+
+
+def bench_list(host, count):
+    for gzip in (False, True):
+        runs = [fetch_list(host, gzip) for _ in range(count)]
+        label = "gzip" if gzip else "plain"
+        print("%-6s %-8s %8d bytes" % (label, runs[0][2], runs[0][1]))
+        describe("  ttlb", [run[0] for run in runs])
+
+
+def bench_contention(host, count):
+    for clients in (1, 4, 8):
+        samples = []
+        busy = [0]
+        lock = threading.Lock()
+
+        def client():
+            for _ in range(count):
+                try:
+                    elapsed_ms = fetch_list(host, False)[0]
+                except urllib.error.HTTPError as error:
+                    if error.code != 429:
+                        raise
+                    with lock:
+                        busy[0] += 1
+                    continue
+                with lock:
+                    samples.append(elapsed_ms)
+
+        threads = [threading.Thread(target=client) for _ in range(clients)]
+        started = time.perf_counter()
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        elapsed = time.perf_counter() - started
+        print("%d client%s  %6.1f lists/s  429s %d" % (clients, "" if clients == 1 else "s",
+                                                       len(samples) / elapsed, busy[0]))
+        if samples:
+            describe("  latency", samples)
+
+
+def timed_get(host, path, headers=None):
+    request = urllib.request.Request(host + path, headers=headers or {})
+    started = time.perf_counter()
+    try:
+        with urllib.request.urlopen(request, timeout=30) as response:
+            response.read()
+    except urllib.error.HTTPError as error:
+        if error.code != 304:
+            raise
+    return (time.perf_counter() - started) * 1000
+
+
+def bench_latency(host, count):
+    _, delta = call(host, "GET", "/api/rumors/changes")
+    up_to_date = "/api/rumors/changes?since=%d&boot=%s" % (delta["version"], delta["boot"])
+    with urllib.request.urlopen(host + "/api/rumors", timeout=30) as response:
+        etag = response.headers.get("ETag")
+    cases = [
+        ("status", "/api/status", {}),
+        ("changes", up_to_date, {}),
+        ("list 304", "/api/rumors", {"If-None-Match": etag}),
+        ("list", "/api/rumors", {}),
+    ]
+    for label, path, headers in cases:
+        describe(label, [timed_get(host, path, headers) for _ in range(count)])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("mode", choices=["batch", "list", "contention", "latency"])
+    parser.add_argument("--host", default="http://192.168.4.1")
+    parser.add_argument("--count", type=int, help="rumors for batch (50, at most 64), fetches for list and latency and per client for contention (20)")
+    args = parser.parse_args()
+    host = args.host.rstrip("/")
+    if args.mode == "batch":
+        bench_batch(host, args.count or 50)
+    elif args.mode == "list":
+        bench_list(host, args.count or 20)
+    elif args.mode == "latency":
+        bench_latency(host, args.count or 20)
+    else:
+        bench_contention(host, args.count or 20)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,93 @@
+"""
+Builds the LittleFS image contents from data/.
+
+Web assets are gzipped and renamed after a hash of their contents, so the
+firmware can serve them with Content-Encoding: gzip and let phones cache
+them forever; a changed file gets a new name. index.html is gzipped but
+keeps its name (it is revalidated on every load) and has its references
+rewritten to the hashed names. Everything else is copied as is.
+
+Runs as a PlatformIO pre-script (see platformio.ini) and points the
+filesystem build at the output directory. Can also be run by hand:
+
+    python scripts/build_data.py [data_dir] [out_dir]
+"""
+
+import gzip
+import hashlib
+import os
+import re
+import shutil
+import sys
+
+HASHED_ASSETS = (".js", ".css")
+PAGES = (".html",)
+ASSET_DIR = "assets"
+
+
+def gzip_bytes(data):
+    # mtime=0 keeps the output identical between builds of the same input.
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def hashed_name(name, data):
+    stem, ext = os.path.splitext(name)
+    return "%s.%s%s" % (stem, hashlib.sha256(data).hexdigest()[:10], ext)
+
+
+def build(src_dir, out_dir):
+    if os.path.isdir(out_dir):
+        shutil.rmtree(out_dir)
+    os.makedirs(os.path.join(out_dir, ASSET_DIR))
+
+    renames = {}
+    pages = []
+    raw_bytes = 0
+    out_bytes = 0
+    for name in sorted(os.listdir(src_dir)):
+        path = os.path.join(src_dir, name)
+        if not os.path.isfile(path):
+            continue
+        with open(path, "rb") as f:
+            data = f.read()
+        ext = os.path.splitext(name)[1].lower()
+        if ext in HASHED_ASSETS:
+            target = hashed_name(name, data)
+            renames[name] = "/%s/%s" % (ASSET_DIR, target)
+            packed = gzip_bytes(data)
+            with open(os.path.join(out_dir, ASSET_DIR, target + ".gz"), "wb") as f:
+                f.write(packed)
+            raw_bytes += len(data)
+            out_bytes += len(packed)
+        elif ext in PAGES:
+            pages.append((name, data))
+        else:
+            shutil.copyfile(path, os.path.join(out_dir, name))
+
+    for name, data in pages:
+        html = data.decode("utf-8")
+        for original, target in renames.items():
+            html = re.sub(r'((?:href|src)=")/?%s(")' % re.escape(original), r"\g<1>%s\g<2>" % target, html)
+        packed = gzip_bytes(html.encode("utf-8"))
+        with open(os.path.join(out_dir, name + ".gz"), "wb") as f:
+            f.write(packed)
+        raw_bytes += len(data)
+        out_bytes += len(packed)
+
+    print("build_data: web assets %d -> %d bytes gzipped, %s" % (raw_bytes, out_bytes,
+                                                                 ", ".join(sorted(renames.values()))))
+
+
+try:
+    Import("env")  # noqa: F821 - provided by SCons
+except NameError:
+    env = None
+
+if env is not None:
+    out = os.path.join(env.subst("$BUILD_DIR"), "data")
+    build(env.subst("$PROJECT_DATA_DIR"), out)
+    env.Replace(PROJECT_DATA_DIR=out)
+elif __name__ == "__main__":
+    here = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    build(sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "data"),
+          sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, ".pio", "build", "data"))
@@ -0,0 +1,34 @@
+#include "api_path.h"
+
+#include <string.h>
+
+bool apiMatchPath(const char *pattern, const char *path, ApiParams &params) {
+  params.count = 0;
+  while (*pattern) {
+    if (*pattern != '{') {
+      if (*pattern != *path) {
+        return false;
+      }
+      ++pattern;
+      ++path;
+      continue;
+    }
+    const char *digits = path;
+    uint32_t value = 0;
+    while (*path >= '0' && *path <= '9') {
+      uint32_t digit = *path - '0';
+      if (value > (UINT32_MAX - digit) / 10) {
+        return false;
+      }
+      value = value * 10 + digit;
+      ++path;
+    }
+    pattern = strchr(pattern, '}');
+    if (path == digits || !pattern || params.count == kApiMaxParams) {
+      return false;
+    }
+    params.values[params.count++] = value;
+    ++pattern;
+  }
+  return *path == '\0';
+}
@@ -0,0 +1,437 @@
+#include "api_router.h"
+
+#include <esp_timer.h>
+#include <lwip/priv/tcp_priv.h>
+#include <lwip/tcpip.h>
+#include <new>
+
+namespace {
+
+const char *const kApiPrefix = "/api/";
+
+std::atomic<uint32_t> busyResponses{0};
+
+// What the server sends for a request handed to a worker. Its calls come
+// from the connection's poll and ack callbacks on async_tcp; until the
+// handler has sent its response they do nothing, after that they go
+// straight to that response. Deleted with the request, which marks the
+// ApiRequest gone.
+class DeferredResponse : public AsyncWebServerResponse {
+ public:
+  explicit DeferredResponse(std::shared_ptr<ApiRequest> request) : request_(std::move(request)) {}
+  ~DeferredResponse() override {
+    request_->gone.store(true, std::memory_order_release);
+    delete inner_;
+  }
+
+  bool _started() const override {
+    return inner_ && inner_->_started();
+  }
+  bool _finished() const override {
+    return inner_ && inner_->_finished();
+  }
+  bool _failed() const override {
+    return inner_ && inner_->_failed();
+  }
+  bool _sourceValid() const override {
+    return true;
+  }
+  void _respond(AsyncWebServerRequest *request) override {
+    start(request);
+  }
+  size_t _ack(AsyncWebServerRequest *request, size_t len, uint32_t time) override {
+    if (inner_) {
+      return inner_->_ack(request, len, time);
+    }
+    start(request);
+    return 0;
+  }
+
+ private:
+  void start(AsyncWebServerRequest *request) {
+    inner_ = request_->takeResponse();
+    if (!inner_) {
+      return;
+    }
+    if (!inner_->_sourceValid()) {
+      delete inner_;
+      inner_ = new AsyncBasicResponse(500);
+    }
+    inner_->_respond(request);
+  }
+
+  std::shared_ptr<ApiRequest> request_;
+  AsyncWebServerResponse *inner_ = nullptr;
+};
+
+// A connection to poll early: its pcb and the AsyncClient that pcb calls
+// back into.
+struct Wake {
+  tcp_pcb *pcb;
+  void *client;
+};
+
+// Runs on the tcpip thread, which owns the pcbs, so the connection can be
+// looked up safely: one that closed meanwhile is no longer in the list. Its
+// poll callback is AsyncTCP's, which queues a poll event for async_tcp.
+void pollOnTcpip(void *arg) {
+  Wake *wake = static_cast<Wake *>(arg);
+  for (tcp_pcb *pcb = tcp_active_pcbs; pcb; pcb = pcb->next) {
+    if (pcb == wake->pcb && pcb->callback_arg == wake->client && pcb->poll) {
+      pcb->poll(pcb->callback_arg, pcb);
+      break;
+    }
+  }
+  delete wake;
+}
+
+}  // namespace
+
+ApiRequest::ApiRequest(AsyncWebServerRequest *request, ApiDoneHandler onDone)
+    : method_(request->method()),
+      contentLength_(request->contentLength()),
+      body_(request->_tempObject),
+      onDone_(onDone) {
+  // The body is ours now; the server would free() it with the request.
+  request->_tempObject = nullptr;
+  for (size_t i = 0; i < request->params(); ++i) {
+    const AsyncWebParameter *param = request->getParam(i);
+    if (!param->isPost() && !param->isFile()) {
+      params_.push_back(Field{param->name(), param->value()});
+    }
+  }
+  for (size_t i = 0; i < request->headers(); ++i) {
+    const AsyncWebHeader *header = request->getHeader(i);
+    headers_.push_back(Field{header->name(), header->value()});
+  }
+}
+
+ApiRequest::~ApiRequest() {
+  delete takeResponse();
+  if (body_) {
+    if (onDone_) {
+      onDone_(body_);
+    } else {
+      free(body_);
+    }
+  }
+}
+
+const ApiRequest::Field *ApiRequest::findField(const std::vector<Field> &fields, const char *name) {
+  for (const auto &field : fields) {
+    if (field.name.equalsIgnoreCase(name)) {
+      return &field;
+    }
+  }
+  return nullptr;
+}
+
+bool ApiRequest::hasParam(const char *name) const {
+  return findField(params_, name) != nullptr;
+}
+
+String ApiRequest::param(const char *name) const {
+  const Field *field = findField(params_, name);
+  return field ? field->value : String();
+}
+
+bool ApiRequest::hasHeader(const char *name) const {
+  return findField(headers_, name) != nullptr;
+}
+
+String ApiRequest::header(const char *name) const {
+  const Field *field = findField(headers_, name);
+  return field ? field->value : String();
+}
+
+AsyncWebServerResponse *ApiRequest::beginResponse(int code, const String &contentType, const String &content) {
+  return new AsyncBasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *ApiRequest::beginResponse(const String &contentType, size_t len, AwsResponseFiller callback) {
+  return new AsyncCallbackResponse(contentType, len, callback);
+}
+
+AsyncWebServerResponse *ApiRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller callback) {
+  return new AsyncChunkedResponse(contentType, callback);
+}
+
+AsyncResponseStream *ApiRequest::beginResponseStream(const String &contentType, size_t bufferSize) {
+  return new AsyncResponseStream(contentType, bufferSize);
+}
+
+void ApiRequest::send(AsyncWebServerResponse *response) {
+  AsyncWebServerResponse *none = nullptr;
+  if (!response_.compare_exchange_strong(none, response, std::memory_order_acq_rel)) {
+    delete response;
+  }
+}
+
+void ApiRequest::send(int code, const String &contentType, const String &content) {
+  send(beginResponse(code, contentType, content));
+}
+
+AsyncWebServerResponse *ApiRequest::takeResponse() {
+  return response_.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+const char *apiMethodName(WebRequestMethod method) {
+  switch (method) {
+    case HTTP_GET:
+      return "GET";
+    case HTTP_POST:
+      return "POST";
+    case HTTP_PUT:
+      return "PUT";
+    case HTTP_PATCH:
+      return "PATCH";
+    case HTTP_DELETE:
+      return "DELETE";
+    default:
+      return "";
+  }
+}
+
+void apiSendBusy(AsyncWebServerRequest *request) {
+  busyResponses.fetch_add(1, std::memory_order_relaxed);
+  AsyncWebServerResponse *response = request->beginResponse(429, "application/json", "{\"error\":\"busy\"}");
+  response->addHeader("Retry-After", "1");
+  request->send(response);
+}
+
+void apiSendBusy(ApiRequest *request) {
+  busyResponses.fetch_add(1, std::memory_order_relaxed);
+  AsyncWebServerResponse *response = request->beginResponse(429, "application/json", "{\"error\":\"busy\"}");
+  response->addHeader("Retry-After", "1");
+  request->send(response);
+}
+
+uint32_t apiBusyCount() {
+  return busyResponses.load(std::memory_order_relaxed);
+}
+
+const ApiRoute *apiMatch(const ApiRoute *routes, size_t count, WebRequestMethodComposite method, const char *path,
+                         ApiParams &params, bool &pathMatched) {
+  pathMatched = false;
+  for (size_t i = 0; i < count; ++i) {
+    if (!apiMatchPath(routes[i].path, path, params)) {
+      continue;
+    }
+    pathMatched = true;
+    if (routes[i].method & method) {
+      return &routes[i];
+    }
+  }
+  return nullptr;
+}
+
+struct ApiRouter::Job {
+  std::shared_ptr<ApiRequest> request;
+  const ApiRoute *route;
+  ApiParams params;
+  int64_t dispatchedUs;
+  // Only handed back to the tcpip thread, never dereferenced here.
+  Wake wake;
+};
+
+bool ApiRouter::begin(uint8_t workers, uint32_t stackBytes, UBaseType_t priority) {
+  QueueHandle_t queue = xQueueCreate(kApiQueueDepth, sizeof(Job *));
+  if (!queue) {
+    return false;
+  }
+  // Set before the workers start; they read it from the router.
+  queue_ = queue;
+  uint8_t started = 0;
+  for (uint8_t i = 0; i < workers; ++i) {
+    char name[16];
+    snprintf(name, sizeof(name), "api-%u", static_cast<unsigned>(i));
+    if (xTaskCreate(workerTask, name, stackBytes, this, priority, nullptr) == pdPASS) {
+      ++started;
+    }
+  }
+  if (started == 0) {
+    queue_ = nullptr;
+    vQueueDelete(queue);
+    return false;
+  }
+  return true;
+}
+
+void ApiRouter::finish(const ApiRoute &route, ApiRequest &request, int64_t dispatchedUs) {
+  if (!request.responded()) {
+    request.send(500);
+  }
+  ApiRouteMetrics &metrics = metrics_[&route - routes_];
+  metrics.requests.fetch_add(1, std::memory_order_relaxed);
+  metrics.latency.record(static_cast<uint32_t>(esp_timer_get_time() - dispatchedUs));
+}
+
+void ApiRouter::workerTask(void *arg) {
+  ApiRouter *router = static_cast<ApiRouter *>(arg);
+  for (;;) {
+    Job *job = nullptr;
+    if (xQueueReceive(router->queue_, &job, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (!job->request->gone.load(std::memory_order_acquire)) {
+      router->queueWait_.record(static_cast<uint32_t>(esp_timer_get_time() - job->dispatchedUs));
+      job->route->onRequest(job->request.get(), job->params);
+      router->finish(*job->route, *job->request, job->dispatchedUs);
+      // Without this the response waits for lwIP's next poll, up to 500 ms.
+      Wake *wake = new (std::nothrow) Wake(job->wake);
+      if (wake && tcpip_callback(pollOnTcpip, wake) != ERR_OK) {
+        delete wake;
+      }
+    }
+    delete job;
+  }
+}
+
+bool ApiRouter::canHandle(AsyncWebServerRequest *request) {
+  const char *path = request->url().c_str();
+  if (strncmp(path, kApiPrefix, strlen(kApiPrefix)) != 0) {
+    return false;
+  }
+  ApiParams params;
+  bool pathMatched = false;
+  const ApiRoute *route = apiMatch(routes_, count_, request->method(), path, params, pathMatched);
+  if (!pathMatched) {
+    return false;
+  }
+  // Headers nobody asked for are dropped while the request is parsed.
+  request->addInterestingHeader("ANY");
+
+  tracked_.push_back(Tracked{request, false, false});
+  ApiDoneHandler onDone = route ? route->onDone : nullptr;
+  request->onDisconnect([this, request, onDone]() {
+    release(request, onDone);
+  });
+  return true;
+}
+
+ApiRouter::Tracked *ApiRouter::find(AsyncWebServerRequest *request) {
+  for (auto &tracked : tracked_) {
+    if (tracked.request == request) {
+      return &tracked;
+    }
+  }
+  return nullptr;
+}
+
+// Runs on async_tcp just before the request is deleted. A body still in
+// _tempObject was never handed to a worker.
+void ApiRouter::release(AsyncWebServerRequest *request, ApiDoneHandler onDone) {
+  for (auto it = tracked_.begin(); it != tracked_.end(); ++it) {
+    if (it->request == request) {
+      tracked_.erase(it);
+      break;
+    }
+  }
+  if (onDone && request->_tempObject) {
+    onDone(request->_tempObject);
+    request->_tempObject = nullptr;
+  }
+}
+
+// Reads pass straight through. Other requests need a free slot, held until
+// the connection closes.
+bool ApiRouter::admit(Tracked &tracked) {
+  if (tracked.holdsSlot || tracked.request->method() == HTTP_GET) {
+    return true;
+  }
+  size_t taken = 0;
+  for (const auto &other : tracked_) {
+    if (other.holdsSlot) {
+      ++taken;
+    }
+  }
+  if (taken >= kApiMaxInFlight) {
+    return false;
+  }
+  tracked.holdsSlot = true;
+  return true;
+}
+
+// Runs the route's onTcp handler here and sends its answer at once. What
+// is left goes to a worker, with the stand-in response for the server, or
+// runs here too before begin().
+void ApiRouter::dispatch(AsyncWebServerRequest *request, const ApiRoute &route, const ApiParams &params) {
+  int64_t now = esp_timer_get_time();
+  std::shared_ptr<ApiRequest> shared(new (std::nothrow) ApiRequest(request, route.onDone));
+  if (!shared) {
+    apiSendBusy(request);
+    return;
+  }
+  if (route.onTcp) {
+    route.onTcp(shared.get(), params);
+  }
+  if (!shared->responded() && route.onRequest) {
+    if (queue_) {
+      // Only async_tcp queues jobs, so there is still room when it comes
+      // to it.
+      AsyncClient *client = request->client();
+      Job *job = uxQueueSpacesAvailable(queue_) == 0
+                     ? nullptr
+                     : new (std::nothrow) Job{shared, &route, params, now, Wake{client->pcb(), client}};
+      if (!job || xQueueSend(queue_, &job, 0) != pdTRUE) {
+        delete job;
+        apiSendBusy(request);
+        return;
+      }
+      request->send(new DeferredResponse(shared));
+      return;
+    }
+    route.onRequest(shared.get(), params);
+  }
+  finish(route, *shared, now);
+  request->send(shared->takeResponse());
+}
+
+void ApiRouter::handleRequest(AsyncWebServerRequest *request) {
+  ApiParams params;
+  bool pathMatched = false;
+  const ApiRoute *route = apiMatch(routes_, count_, request->method(), request->url().c_str(), params, pathMatched);
+  Tracked *tracked = find(request);
+  if (route && tracked) {
+    // A request turned away while its body came in already has its answer.
+    if (tracked->rejected) {
+      return;
+    }
+    if (!admit(*tracked)) {
+      apiSendBusy(request);
+      return;
+    }
+    dispatch(request, *route, params);
+    return;
+  }
+  String allow;
+  for (size_t i = 0; i < count_; ++i) {
+    if (apiMatchPath(routes_[i].path, request->url().c_str(), params)) {
+      if (allow.length() > 0) {
+        allow += ", ";
+      }
+      allow += apiMethodName(routes_[i].method);
+    }
+  }
+  AsyncWebServerResponse *response = request->beginResponse(405);
+  response->addHeader("Allow", allow);
+  request->send(response);
+}
+
+void ApiRouter::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  ApiParams params;
+  bool pathMatched = false;
+  const ApiRoute *route = apiMatch(routes_, count_, request->method(), request->url().c_str(), params, pathMatched);
+  Tracked *tracked = find(request);
+  if (!route || !route->onBody || !tracked || tracked->rejected) {
+    return;
+  }
+  if (index == 0 && !admit(*tracked)) {
+    tracked->rejected = true;
+    apiSendBusy(request);
+    return;
+  }
+  if (!route->onBody(request, data, len, index, total)) {
+    tracked->rejected = true;
+  }
+}
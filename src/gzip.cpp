@@ -0,0 +1,207 @@
+#include "gzip.h"
+
+#include <string.h>
+
+namespace {
+
+// RFC 1951 3.2.5: length codes 257..285 and distance codes 0..29.
+const uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                  31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                  2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// CRC-32 (IEEE), four bits at a time.
+const uint32_t kCrcNibble[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+                                 0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+uint32_t crcUpdate(uint32_t crc, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ kCrcNibble[crc & 15];
+    crc = (crc >> 4) ^ kCrcNibble[crc & 15];
+  }
+  return crc;
+}
+
+// Multiplicative hash of the next three bytes; callers keep the top bits.
+uint32_t hash3(const uint8_t *p) {
+  uint32_t value = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+  return value * 2654435761u;
+}
+
+// Huffman codes go out most significant bit first inside the LSB-first
+// bit stream.
+uint16_t reverseBits(uint16_t code, uint8_t bits) {
+  uint16_t out = 0;
+  for (uint8_t i = 0; i < bits; ++i) {
+    out = (out << 1) | (code & 1);
+    code >>= 1;
+  }
+  return out;
+}
+
+template <size_t N, typename T>
+size_t codeFor(const T (&base)[N], size_t value) {
+  size_t code = N - 1;
+  while (base[code] > value) {
+    --code;
+  }
+  return code;
+}
+
+}  // namespace
+
+GzipWriter::GzipWriter(std::vector<uint8_t> &out) : out_(out) {
+  static_assert((1u << kHashBits) == sizeof(head_) / sizeof(head_[0]), "hash table size");
+  // Start every chain out of reach of the first kWindow bytes.
+  for (auto &entry : head_) {
+    entry = 0x8000;
+  }
+  memset(prev_, 0, sizeof(prev_));
+  // ID1 ID2, deflate, no flags, no mtime, no extra flags, OS unknown.
+  static const uint8_t kHeader[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+  out_.insert(out_.end(), kHeader, kHeader + sizeof(kHeader));
+  // One final block with the fixed codes, ended by finish().
+  writeBits(1, 1);
+  writeBits(1, 2);
+}
+
+void GzipWriter::write(const uint8_t *data, size_t len) {
+  crc_ = crcUpdate(crc_, data, len);
+  size_ += len;
+  while (len > 0) {
+    if (fill_ == sizeof(buf_)) {
+      // compress() leaves at most kMaxMatch bytes, so pos_ is past the
+      // first half and the second half is still a full window behind it.
+      memmove(buf_, buf_ + kWindow, fill_ - kWindow);
+      base_ += kWindow;
+      fill_ -= kWindow;
+      pos_ -= kWindow;
+    }
+    size_t n = sizeof(buf_) - fill_;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(buf_ + fill_, data, n);
+    fill_ += n;
+    data += n;
+    len -= n;
+    compress(false);
+  }
+}
+
+void GzipWriter::finish() {
+  compress(true);
+  writeSymbol(256);
+  if (bitCount_ > 0) {
+    writeBits(0, 8 - bitCount_);
+  }
+  uint32_t crc = ~crc_;
+  for (int i = 0; i < 4; ++i) {
+    out_.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+  }
+  for (int i = 0; i < 4; ++i) {
+    out_.push_back(static_cast<uint8_t>(size_ >> (8 * i)));
+  }
+}
+
+void GzipWriter::insert(size_t at) {
+  uint16_t position = static_cast<uint16_t>(base_ + at);
+  uint32_t slot = hash3(buf_ + at) >> (32 - kHashBits);
+  prev_[position & kWindowMask] = head_[slot];
+  head_[slot] = position;
+}
+
+// Until flushing, keeps kMaxMatch bytes of lookahead so a match is never
+// cut short by a write boundary.
+void GzipWriter::compress(bool flush) {
+  while (pos_ < fill_ && (flush || fill_ - pos_ >= kMaxMatch)) {
+    size_t avail = fill_ - pos_;
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    if (avail >= kMinMatch) {
+      size_t maxLength = avail < kMaxMatch ? avail : kMaxMatch;
+      uint16_t position = static_cast<uint16_t>(base_ + pos_);
+      uint16_t candidate = head_[hash3(buf_ + pos_) >> (32 - kHashBits)];
+      size_t lastDistance = 0;
+      for (size_t chain = 0; chain < kMaxChain; ++chain) {
+        size_t distance = static_cast<uint16_t>(position - candidate);
+        // Chains only go back in time; anything else is a stale entry.
+        if (distance <= lastDistance || distance > kWindow || distance > pos_) {
+          break;
+        }
+        lastDistance = distance;
+        const uint8_t *a = buf_ + pos_;
+        const uint8_t *b = a - distance;
+        size_t length = 0;
+        while (length < maxLength && a[length] == b[length]) {
+          ++length;
+        }
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = distance;
+          if (length == maxLength) {
+            break;
+          }
+        }
+        candidate = prev_[candidate & kWindowMask];
+      }
+      insert(pos_);
+    }
+    if (bestLength >= kMinMatch) {
+      emitMatch(bestLength, bestDistance);
+      for (size_t i = 1; i < bestLength && pos_ + i + kMinMatch <= fill_; ++i) {
+        insert(pos_ + i);
+      }
+      pos_ += bestLength;
+    } else {
+      emitLiteral(buf_[pos_]);
+      ++pos_;
+    }
+  }
+}
+
+void GzipWriter::emitLiteral(uint8_t value) {
+  writeSymbol(value);
+}
+
+void GzipWriter::emitMatch(size_t length, size_t distance) {
+  size_t code = codeFor(kLengthBase, length);
+  writeSymbol(257 + code);
+  writeBits(length - kLengthBase[code], kLengthExtra[code]);
+  code = codeFor(kDistanceBase, distance);
+  writeCode(code, 5);
+  writeBits(distance - kDistanceBase[code], kDistanceExtra[code]);
+}
+
+// RFC 1951 3.2.6, the fixed literal/length code.
+void GzipWriter::writeSymbol(uint16_t symbol) {
+  if (symbol < 144) {
+    writeCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    writeCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    writeCode(symbol - 256, 7);
+  } else {
+    writeCode(0xC0 + symbol - 280, 8);
+  }
+}
+
+void GzipWriter::writeCode(uint16_t code, uint8_t bits) {
+  writeBits(reverseBits(code, bits), bits);
+}
+
+void GzipWriter::writeBits(uint32_t value, uint8_t bits) {
+  bitBuffer_ |= value << bitCount_;
+  bitCount_ += bits;
+  while (bitCount_ >= 8) {
+    out_.push_back(static_cast<uint8_t>(bitBuffer_));
+    bitBuffer_ >>= 8;
+    bitCount_ -= 8;
+  }
+}
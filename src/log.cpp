@@ -0,0 +1,229 @@
+#include "log.h"
+
+#include <LittleFS.h>
+#include <esp_timer.h>
+
+#include <atomic>
+
+namespace {
+
+const char *const kLogPath = "/log.txt";
+const char *const kLogOldPath = "/log.1.txt";
+// The file is moved to kLogOldPath at this size, so the log never takes
+// more than twice this on flash.
+const size_t kLogFileMaxBytes = 32 * 1024;
+// Formatted text is collected up to this size before it is written out.
+const size_t kLogFlushBytes = 512;
+
+const char *const kFormats[kLogEventCount] = {
+    "%s",
+    "[log] %u records dropped",
+    "[rumor] JSON parse failed at rumor %u: %s",
+    "[rumor] loaded %u rumors",
+    "[rumor] imported %u rumors%s%s",
+    "[config] JSON parse failed: %s",
+    "[config] ignoring stored config: %s",
+    "[config] cooldown=%ums depth=%u policy=%s",
+    "[print] %s attempt %u: %s",
+    "[print] %s: no eligible rumors",
+    "[print] %s printing rumor id=%u title=%s",
+    "[print] %s burst of %u not confirmed: %s",
+    "[print] %s job failed, giving up",
+    "[print] %s idle, printer asleep",
+    "[print] %s: %u trigger(s) received",
+    "[reed] %s trigger %s",
+    "[reed] %s trigger rejected, cooling down",
+    "[power] light sleep unavailable (%s), frequency scaling only",
+    "[power] low-power mode, light sleep %s",
+    "[setup] %s printer ready",
+    "[wifi] AP up: %s",
+    "[wifi] AP IP: %s",
+};
+
+// Same scheme as the trace ring: a slot is valid while its seq matches the
+// one the reader expects, and writers clear it first.
+struct LogSlot {
+  std::atomic<uint32_t> seq{0};
+  LogRecord record;
+};
+
+LogSlot slots[kLogCapacity];
+std::atomic<uint32_t> nextSeq{1};
+// Everything before this has been printed.
+std::atomic<uint32_t> drainedSeq{1};
+TaskHandle_t drainTask = nullptr;
+std::atomic<bool> fileEnabled{false};
+
+// Appends the formatted record and a newline to `out`.
+void format(const LogRecord &record, String &out) {
+  char number[24];
+  snprintf(number, sizeof(number), "%u.%03u ", static_cast<unsigned>(record.atUs / 1000000),
+           static_cast<unsigned>(record.atUs / 1000 % 1000));
+  out += number;
+  if (record.event >= kLogEventCount) {
+    snprintf(number, sizeof(number), "[log] event %u\n", static_cast<unsigned>(record.event));
+    out += number;
+    return;
+  }
+  uint8_t arg = 0;
+  for (const char *p = kFormats[record.event]; *p; ++p) {
+    if (*p != '%' || !p[1]) {
+      out += *p;
+      continue;
+    }
+    char spec = *++p;
+    if (spec == '%') {
+      out += '%';
+      continue;
+    }
+    bool isText = arg == record.textArg;
+    uintptr_t value = arg < record.argCount ? record.args[arg] : 0;
+    ++arg;
+    switch (spec) {
+      case 's':
+        if (isText) {
+          out += record.text;
+        } else {
+          const char *text = reinterpret_cast<const char *>(value);
+          out += text ? text : "(null)";
+        }
+        break;
+      case 'd':
+        snprintf(number, sizeof(number), "%d", static_cast<int>(value));
+        out += number;
+        break;
+      case 'x':
+        snprintf(number, sizeof(number), "%x", static_cast<unsigned>(value));
+        out += number;
+        break;
+      default:
+        snprintf(number, sizeof(number), "%u", static_cast<unsigned>(value));
+        out += number;
+        break;
+    }
+  }
+  out += '\n';
+}
+
+void appendToFile(const String &text) {
+  File file = LittleFS.open(kLogPath, "a");
+  if (!file) {
+    return;
+  }
+  if (file.size() + text.length() > kLogFileMaxBytes) {
+    file.close();
+    LittleFS.remove(kLogOldPath);
+    LittleFS.rename(kLogPath, kLogOldPath);
+    file = LittleFS.open(kLogPath, "w");
+    if (!file) {
+      return;
+    }
+  }
+  file.write(reinterpret_cast<const uint8_t *>(text.c_str()), text.length());
+  file.close();
+}
+
+void flush(String &text) {
+  if (text.length() == 0) {
+    return;
+  }
+  Serial.write(reinterpret_cast<const uint8_t *>(text.c_str()), text.length());
+  if (fileEnabled.load(std::memory_order_relaxed)) {
+    appendToFile(text);
+  }
+  text = "";
+}
+
+// Prints everything published so far. False when it stopped at a slot
+// whose writer has not finished yet.
+bool drain(String &text) {
+  uint32_t seq = drainedSeq.load(std::memory_order_relaxed);
+  uint32_t end = nextSeq.load(std::memory_order_acquire);
+  uint32_t lost = 0;
+  if (end - seq > kLogCapacity) {
+    lost = end - kLogCapacity - seq;
+    seq = end - kLogCapacity;
+  }
+  bool complete = true;
+  for (; seq != end; ++seq) {
+    const LogSlot &slot = slots[seq % kLogCapacity];
+    uint32_t slotSeq = slot.seq.load(std::memory_order_acquire);
+    if (slotSeq != seq) {
+      if (static_cast<int32_t>(slotSeq - seq) > 0) {
+        // Already overwritten by a newer record.
+        ++lost;
+        continue;
+      }
+      complete = false;
+      break;
+    }
+    LogRecord record = slot.record;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) {
+      ++lost;
+      continue;
+    }
+    format(record, text);
+    if (text.length() >= kLogFlushBytes) {
+      flush(text);
+    }
+  }
+  // Ordered against logReserve()'s fetch_add (both seq_cst): either the
+  // writer sees this and wakes the task, or the task sees its record.
+  drainedSeq.store(seq);
+  if (lost > 0) {
+    LogRecord record = {};
+    record.atUs = esp_timer_get_time();
+    record.event = kLogDropped;
+    record.argCount = 1;
+    record.textArg = kLogNoText;
+    record.args[0] = lost;
+    format(record, text);
+  }
+  flush(text);
+  return complete;
+}
+
+void drainTaskMain(void *) {
+  String text;
+  text.reserve(kLogFlushBytes + 128);
+  for (;;) {
+    // A writer caught mid-record is finished on the next tick.
+    bool complete = drain(text);
+    if (complete && nextSeq.load() != drainedSeq.load()) {
+      continue;
+    }
+    ulTaskNotifyTake(pdTRUE, complete ? portMAX_DELAY : 1);
+  }
+}
+
+}  // namespace
+
+void logBegin() {
+  if (!drainTask) {
+    xTaskCreate(drainTaskMain, "log", 4096, nullptr, tskIDLE_PRIORITY, &drainTask);
+  }
+}
+
+void logEnableFile() {
+  fileEnabled.store(true, std::memory_order_relaxed);
+}
+
+LogRecord &logReserve(uint32_t &seq) {
+  int64_t now = esp_timer_get_time();
+  seq = nextSeq.fetch_add(1);
+  LogSlot &slot = slots[seq % kLogCapacity];
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.record.atUs = now;
+  return slot.record;
+}
+
+void logPublish(uint32_t seq) {
+  slots[seq % kLogCapacity].seq.store(seq, std::memory_order_release);
+  // Only the first record after the ring went idle wakes the drain task;
+  // the rest of a burst is picked up by the same pass.
+  if (seq == drainedSeq.load() && drainTask) {
+    xTaskNotifyGive(drainTask);
+  }
+}
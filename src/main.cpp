@@ -5,8 +5,25 @@
 #include <LittleFS.h>
 #include <ArduinoJson.h>
 #include <Adafruit_Thermal.h>
+#include <esp_timer.h>
+#include <esp_pm.h>
+#include <driver/gpio.h>
+#include <hal/gpio_ll.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
 #include <vector>
 
+#include "api_router.h"
+#include "gzip.h"
+#include "log.h"
+#include "metrics.h"
+#include "rumor.h"
+#include "rw_lock.h"
+#include "slip.h"
+#include "trace.h"
+
 /*
   V&V Rumour mill
 
@@ -17,53 +34,313 @@
    1x QR204 58mm thermal panel printer
    1x 2A 5v powersupply
 
-  Connections:
+  Connections (first mill, see kMillPins for the others):
     Printer     ESP32
     RX   -->    TX2
     TX   -->    RX2
     GND  -->    GND
+    Reed switch between GPIO4 and GND
     Connect 5v and GND to powersupply 5V and GND
+
+  Low-power mode (build with -DRUMOURMILL_LOW_POWER=1) lets the chip drop
+  into automatic light sleep between triggers. The reed switch wakes it via
+  a GPIO level wakeup and the AP keeps serving in modem sleep, at the cost of
+  a few ms extra on the first HTTP response after a quiet spell. Each mill
+  keeps the chip out of light sleep while it runs a print job, from the
+  status check through printing to committing the counts.
 */
 
+#ifndef RUMOURMILL_LOW_POWER
+#define RUMOURMILL_LOW_POWER 0
+#endif
+
+// Also keep the log in /log.txt on LittleFS (rotated at 32 KB to
+// /log.1.txt), for mills left running without a console attached.
+#ifndef RUMOURMILL_LOG_FILE
+#define RUMOURMILL_LOG_FILE 0
+#endif
+
+// Number of mills (reed switch + printer pairs) wired to this controller.
+#ifndef RUMOURMILL_MILLS
+#define RUMOURMILL_MILLS 1
+#endif
+
 static const char *kApSsid = "RumourMill";
 static const char *kApPassword = "OhNoSheDidnt";
 static const char *kRumorsPath = "/rumors.json";
+static const char *kConfigPath = "/config.json";
+
+// Largest accepted request body; anything bigger gets a 413 before it is
+// buffered. A rumor with long texts in both languages fits easily.
+static const size_t kMaxBodyBytes = 4096;
+// Parsed bodies only hold the JSON tree (strings stay in the body buffer),
+// so this covers a rumor or the config with room to spare.
+static const size_t kBodyDocSize = 768;
+// PATCH /api/rumors: enough for a storyline's worth of toggles or resets in
+// one request.
+static const size_t kMaxBatchBodyBytes = 16384;
+// No more than the change log holds (kChangeLogSize).
+static const size_t kMaxBatchOps = 64;
+static const size_t kBatchDocSize = 12288;
+// Most one rumor may take in the store file, serialized. Partial PUTs could
+// otherwise grow a rumor field by field past what loading it back takes;
+// create, update and import answer 413 instead.
+static const size_t kMaxRumorBytes = 6144;
+// Room for one rumor read back from the store file, strings copied into the
+// document. Covers kMaxRumorBytes; bigger elements (saved before the cap,
+// or edited by hand) are read again into documents up to the second size.
+static const size_t kStoredRumorDocSize = 2 * kMaxBodyBytes;
+static const size_t kMaxStoredRumorDocSize = 8 * kStoredRumorDocSize;
+// API handlers run on this many worker tasks (see api_router.h), which also
+// caps how many readers hold the store lock for the API at once. How long
+// one waits for the store, or for another worker compressing a cached body,
+// before giving up with a 429 or an uncompressed body.
+static const uint8_t kApiWorkers = 2;
+static const uint32_t kRequestLockWaitMs = 200;
+static const uint32_t kGzipCacheWaitMs = 1000;
 
 static const int kLedPin = 2;
-static const int kReedPin = 4;
-static const uint32_t kReedPollMs = 50;
-static const uint32_t kPrintCooldownMs = 15000;
 
-static const uint16_t kDefaultMaxPrints = 5;
+// One reed switch and one printer per mill. UART0 is the console, so the
+// ESP32 has two UARTs left for printers and the S2 only one.
+struct MillPins {
+  const char *name;
+  int reedPin;
+  HardwareSerial *uart;
+  int rxPin;
+  int txPin;
+};
+
+static const MillPins kMillPins[] = {
+    {"mill1", 4, &Serial1, 16, 17},
+#if RUMOURMILL_MILLS > 1 && SOC_UART_NUM > 2
+    {"mill2", 27, &Serial2, 25, 26},
+#endif
+};
+static const size_t kMillCount = sizeof(kMillPins) / sizeof(kMillPins[0]);
+static_assert(kMillCount == RUMOURMILL_MILLS,
+              "RUMOURMILL_MILLS is more mills than this board has UARTs and pins for (see kMillPins)");
+static const size_t kPoolNameMax = 24;
+// The reed interrupt is held off for this long after a trigger (and while the
+// magnet is still present) to ride out contact bounce.
+static const uint32_t kReedDebounceMs = 30;
+// Trigger admission defaults, adjustable at runtime through /api/config.
+static const uint32_t kPrintCooldownMs = 15000;
+static const uint8_t kPrintQueueDepth = 4;
+static const uint32_t kMaxCooldownMs = 600000;
+// The queue is allocated at this size; the configured depth is enforced on
+// top of it so it can change without recreating the queue.
+static const uint8_t kPrintQueueCapacity = 16;
+
+static const uint32_t kPrinterStatusTimeoutMs = 500;
+static const uint32_t kPrintConfirmTimeoutMs = 4000;
+static const uint8_t kPrintMaxAttempts = 3;
+static const uint32_t kPrintRetryDelayMs = 3000;
+// The printer is put to sleep only after this long without a job.
+static const uint32_t kPrinterIdleSleepMs = 30000;
 
-Adafruit_Thermal printer(&Serial1);
 AsyncWebServer server(80);
-SemaphoreHandle_t rumorsMutex;
-QueueHandle_t printQueue;
-
-struct Rumor {
-  uint32_t id = 0;
-  String title;
-  String textNl;
-  String textEn;
-  String people;
-  bool active = true;
-  uint16_t maxPrints = kDefaultMaxPrints;
-  uint16_t printedCount = 0;
+// Change notifications for the web UI, sent through pushToClients().
+AsyncWebSocket events("/api/events");
+RwLock rumorsLock;
+
+struct PrinterStatus {
+  bool online = false;
+  bool paper = false;
+  bool overheated = false;
+  uint32_t checkedAt = 0;
+
+  bool ready() const {
+    return online && paper && !overheated;
+  }
 };
 
-static std::vector<Rumor> rumors;
+struct PrintStats {
+  uint32_t printed = 0;
+  uint32_t failed = 0;
+  uint32_t retries = 0;
+  const char *lastError = nullptr;
+  uint32_t lastErrorAt = 0;
+  // Reed edge to first slip byte, for comparing power modes.
+  uint32_t lastLatencyMs = 0;
+  uint32_t maxLatencyMs = 0;
+  uint64_t latencySumMs = 0;
+  uint32_t latencySamples = 0;
+};
+
+// What to do with a trigger that passes the cooldown but finds a job
+// already waiting (coalesce) or the queue at its configured depth.
+enum TriggerPolicy : uint8_t {
+  kPolicyDropNewest,
+  kPolicyDropOldest,
+  kPolicyCoalesce,
+};
+
+// Runtime settings shared by all mills, plus each mill's rumor pool. An
+// empty pool prints any rumor; otherwise only rumors tagged with that pool.
+struct MillConfig {
+  uint32_t cooldownMs = kPrintCooldownMs;
+  uint8_t queueDepth = kPrintQueueDepth;
+  TriggerPolicy policy = kPolicyDropNewest;
+  // Bitmap slips instead of the printer's own font; much slower to send.
+  bool rasterSlips = false;
+  char pools[kMillCount][kPoolNameMax] = {};
+};
+
+struct TriggerStats {
+  uint32_t accepted = 0;
+  uint32_t rejectedCooldown = 0;
+  uint32_t dropped = 0;
+  uint32_t coalesced = 0;
+};
+
+// Queue item; the edge time survives queueing so latency covers the whole
+// path from the magnet to the print head.
+struct PrintTrigger {
+  int64_t edgeUs = 0;
+  uint16_t job = 0;
+};
+
+// Everything one mill owns. Each mill has its own queue and print task, so a
+// slow or jammed printer only ever holds up its own triggers; the rumor store
+// is the only thing they share.
+struct Mill {
+  Mill(const MillPins &millPins, uint8_t millIndex)
+      : pins(millPins),
+        index(millIndex),
+        reedGpio(static_cast<gpio_num_t>(millPins.reedPin)),
+        printer(millPins.uart),
+        slips(printer, millIndex) {}
+
+  const MillPins &pins;
+  const uint8_t index;
+  // Copied out of kMillPins (flash) so the ISR only touches RAM.
+  const gpio_num_t reedGpio;
+  Adafruit_Thermal printer;
+  SlipPrinter slips;
+  QueueHandle_t queue = nullptr;
+  esp_timer_handle_t debounceTimer = nullptr;
+  volatile int64_t edgeUs = 0;
+  // Owned by reedTask.
+  uint32_t lastTrigger = 0;
+  // Owned by this mill's print task.
+  bool printerAsleep = false;
+  // Held while a job runs, in low-power mode: UART RX does not wake the
+  // chip from light sleep, so the printer's status reply would be lost.
+  esp_pm_lock_handle_t awakeLock = nullptr;
+  // Guarded by printStatusMux.
+  PrinterStatus status;
+  PrintStats stats;
+  TriggerStats triggers;
+};
 
+static std::vector<Rumor> rumors;
+// Set once loadRumors() has read the store file or created it. Until then
+// saves are refused, so a file that failed to load is never overwritten
+// with whatever the API put in the empty store.
+static bool rumorsLoaded = false;
+static Mill *mills[kMillCount];
+static portMUX_TYPE printStatusMux = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE millConfigMux = portMUX_INITIALIZER_UNLOCKED;
+static MillConfig millConfig;
+static TaskHandle_t reedTaskHandle = nullptr;
+static TaskHandle_t pushTaskHandle = nullptr;
+static std::atomic<uint32_t> rumorsVersion{1};
+// Prints reserved and not yet committed or released, kept next to the
+// per-rumor counts so /api/status can report it without the store lock.
+static std::atomic<uint32_t> rumorsReserved{0};
+
+// Recent store changes for /api/rumors/changes, written under the rumors lock.
+// One entry per rumor touched, several of them under one version when a
+// batch changes many rumors at once; every entry above changeLogFloor is
+// still in the ring.
+struct RumorChange {
+  uint32_t version = 0;
+  uint32_t rumorId = 0;
+};
+static const size_t kChangeLogSize = 64;
+static RumorChange changeLog[kChangeLogSize];
+static size_t changeLogNext = 0;
+static uint32_t changeLogFloor = 1;
+// A full batch fits in the change log, so it never pushes clients that were
+// up to date before it into a full resync.
+static_assert(kMaxBatchOps <= kChangeLogSize, "a batch must fit in the change log");
+// Random per boot so ETags from before a restart never match.
+static uint32_t bootId = 0;
+static bool lightSleepEnabled = false;
+
+// For fixed messages; anything with values gets its own LogEvent.
 static void logLine(const char *message) {
-  Serial.println(message);
+  logEvent(kLogText, message);
+}
+
+void slipLog(const char *message) {
+  logLine(message);
 }
 
+// Store timings and counts for /api/metrics. Hold time is only tracked for
+// the exclusive lock, which has a single holder to remember the start of.
+struct StoreMetrics {
+  MetricHistogram lockWaitShared;
+  MetricHistogram lockWaitExclusive;
+  MetricHistogram lockHoldExclusive;
+  MetricHistogram saveDuration;
+  std::atomic<uint32_t> saves;
+  std::atomic<uint32_t> saveFailures;
+  std::atomic<uint32_t> saveBytes;
+};
+static StoreMetrics storeMetrics;
+// Written by the exclusive holder only.
+static int64_t rumorsLockedAtUs = 0;
+
+// Exclusive, for anything that changes the store (including a pick, which
+// reserves rumors).
 static bool lockRumors(uint32_t timeoutMs) {
-  return xSemaphoreTake(rumorsMutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE;
+  int64_t startUs = esp_timer_get_time();
+  if (!rumorsLock.lock(timeoutMs)) {
+    return false;
+  }
+  rumorsLockedAtUs = esp_timer_get_time();
+  storeMetrics.lockWaitExclusive.record(static_cast<uint32_t>(rumorsLockedAtUs - startUs));
+  return true;
 }
 
 static void unlockRumors() {
-  xSemaphoreGive(rumorsMutex);
+  storeMetrics.lockHoldExclusive.record(static_cast<uint32_t>(esp_timer_get_time() - rumorsLockedAtUs));
+  rumorsLock.unlock();
+}
+
+// Shared, for readers: lists, change feeds and exports run side by side.
+static bool lockRumorsShared(uint32_t timeoutMs) {
+  int64_t startUs = esp_timer_get_time();
+  if (!rumorsLock.lockShared(timeoutMs)) {
+    return false;
+  }
+  storeMetrics.lockWaitShared.record(static_cast<uint32_t>(esp_timer_get_time() - startUs));
+  return true;
+}
+
+static void unlockRumorsShared() {
+  rumorsLock.unlockShared();
+}
+
+// Web handlers run on the API workers, so they can wait a little for the
+// store, e.g. for a slip being picked; past that the client is sent back
+// with a 429 to retry shortly rather than holding a worker.
+static bool lockRumorsForRequest(ApiRequest *request) {
+  if (lockRumors(kRequestLockWaitMs)) {
+    return true;
+  }
+  apiSendBusy(request);
+  return false;
+}
+
+static bool lockRumorsSharedForRequest(ApiRequest *request) {
+  if (lockRumorsShared(kRequestLockWaitMs)) {
+    return true;
+  }
+  apiSendBusy(request);
+  return false;
 }
 
 static uint32_t nextRumorId() {
@@ -76,41 +353,198 @@ static uint32_t nextRumorId() {
   return maxId + 1;
 }
 
-static bool saveRumorsLocked() {
-  DynamicJsonDocument doc(1024 + rumors.size() * 256);
-  JsonArray arr = doc.to<JsonArray>();
+static Rumor *findRumorLocked(uint32_t rumorId) {
+  for (auto &rumor : rumors) {
+    if (rumor.id == rumorId) {
+      return &rumor;
+    }
+  }
+  return nullptr;
+}
+
+// Push notifications are dirty bits on pushTask: raising one never blocks
+// or allocates, and any number of changes before pushTask runs collapse
+// into one message carrying the current value.
+static const uint32_t kPushStoreBit = 1UL << 0;
+static const uint32_t kPushCleanupMs = 1000;
+
+static uint32_t pushQueueBit(uint8_t mill) {
+  return 1UL << (1 + mill);
+}
+
+static uint32_t pushPrintBit(uint8_t mill) {
+  return 1UL << (8 + mill);
+}
+
+static void notifyPush(uint32_t bits) {
+  if (pushTaskHandle) {
+    xTaskNotify(pushTaskHandle, bits, eSetBits);
+  }
+}
+
+static void writeRumorJson(JsonObject obj, const Rumor &rumor) {
+  obj["id"] = rumor.id;
+  obj["title"] = rumor.title;
+  obj["text_nl"] = rumor.textNl;
+  obj["text_en"] = rumor.textEn;
+  obj["people"] = rumor.people;
+  obj["pool"] = rumor.pool;
+  obj["active"] = rumor.active;
+  obj["max_prints"] = rumor.maxPrints;
+  obj["printed_count"] = rumor.printedCount;
+}
+
+// Capacity for one rumor from writeRumorJson(); the strings are copied in.
+static size_t rumorDocSize(const Rumor &rumor) {
+  return JSON_OBJECT_SIZE(9) + rumor.title.length() + rumor.textNl.length() + rumor.textEn.length() +
+         rumor.people.length() + rumor.pool.length() + 16;
+}
+
+static size_t rumorJsonLength(const Rumor &rumor) {
+  DynamicJsonDocument doc(rumorDocSize(rumor));
+  writeRumorJson(doc.to<JsonObject>(), rumor);
+  return measureJson(doc);
+}
+
+static bool rumorFitsStore(const Rumor &rumor) {
+  return rumorJsonLength(rumor) <= kMaxRumorBytes;
+}
+
+static void refreshRumorJson(Rumor &rumor) {
+  DynamicJsonDocument doc(rumorDocSize(rumor));
+  writeRumorJson(doc.to<JsonObject>(), rumor);
+  rumor.json = "";
+  serializeJson(doc, rumor.json);
+}
+
+// Sum of the cached fragments plus a separator each.
+static size_t rumorsJsonLengthLocked() {
+  size_t length = 0;
   for (const auto &rumor : rumors) {
-    JsonObject obj = arr.createNestedObject();
-    obj["id"] = rumor.id;
-    obj["title"] = rumor.title;
-    obj["text_nl"] = rumor.textNl;
-    obj["text_en"] = rumor.textEn;
-    obj["people"] = rumor.people;
-    obj["active"] = rumor.active;
-    obj["max_prints"] = rumor.maxPrints;
-    obj["printed_count"] = rumor.printedCount;
-  }
-
-  File file = LittleFS.open(kRumorsPath, "w");
+    length += rumor.json.length() + 1;
+  }
+  return length;
+}
+
+// Every change visible through the API bumps the store version by one and
+// logs the rumors it touched against the new version. The version is read
+// without the lock, so a conditional GET never waits on the store. rumorId 0
+// stands for a change to every rumor. Also refreshes the cached JSON of what
+// changed, which is why every mutation has to come through here.
+static void markRumorsChangedLocked(const uint32_t *rumorIds, size_t count) {
+  for (auto &rumor : rumors) {
+    for (size_t i = 0; i < count; ++i) {
+      if (rumorIds[i] == 0 || rumor.id == rumorIds[i]) {
+        refreshRumorJson(rumor);
+        break;
+      }
+    }
+  }
+  uint32_t version = rumorsVersion.fetch_add(1, std::memory_order_release) + 1;
+  for (size_t i = 0; i < count; ++i) {
+    RumorChange &slot = changeLog[changeLogNext];
+    changeLogNext = (changeLogNext + 1) % kChangeLogSize;
+    if (slot.version != 0) {
+      // Overwriting the oldest entry: clients behind it need a full resync.
+      changeLogFloor = slot.version;
+    }
+    slot.version = version;
+    slot.rumorId = rumorIds[i];
+  }
+  notifyPush(kPushStoreBit);
+}
+
+static void markRumorChangedLocked(uint32_t rumorId) {
+  markRumorsChangedLocked(&rumorId, 1);
+}
+
+static void readStoredRumor(JsonObjectConst obj, Rumor &rumor) {
+  rumor.id = obj["id"] | 0;
+  rumor.title = obj["title"] | "";
+  rumor.textNl = obj["text_nl"] | "";
+  rumor.textEn = obj["text_en"] | "";
+  rumor.people = obj["people"] | "";
+  rumor.pool = obj["pool"] | "";
+  rumor.active = obj["active"] | true;
+  rumor.maxPrints = obj["max_prints"] | kDefaultMaxPrints;
+  rumor.printedCount = obj["printed_count"] | 0;
+  refreshRumorRevision(rumor);
+}
+
+// Reads the element at start again into ever bigger documents after it
+// outgrew the shared one.
+static DeserializationError readLargeStoredRumor(File &file, size_t start, Rumor &rumor) {
+  DeserializationError err = DeserializationError::NoMemory;
+  for (size_t capacity = 2 * kStoredRumorDocSize;
+       err == DeserializationError::NoMemory && capacity <= kMaxStoredRumorDocSize; capacity *= 2) {
+    if (!file.seek(start)) {
+      break;
+    }
+    DynamicJsonDocument doc(capacity);
+    err = deserializeJson(doc, file);
+    if (!err) {
+      readStoredRumor(doc.as<JsonObjectConst>(), rumor);
+    }
+  }
+  return err;
+}
+
+// Written from the cached fragments, so saving copies bytes and needs no
+// document however big the library is. The file is swapped in only once
+// it is complete.
+static bool writeRumorsFileLocked(size_t &bytes) {
+  String tmpPath = String(kRumorsPath) + ".tmp";
+  File file = LittleFS.open(tmpPath, "w");
   if (!file) {
     return false;
   }
-  serializeJson(doc, file);
+  bool ok = file.print('[') == 1;
+  for (size_t i = 0; i < rumors.size() && ok; ++i) {
+    if (i > 0) {
+      ok = file.print(',') == 1;
+    }
+    const String &json = rumors[i].json;
+    ok = ok && file.write(reinterpret_cast<const uint8_t *>(json.c_str()), json.length()) == json.length();
+    bytes += json.length() + (i > 0);
+  }
+  ok = ok && file.print(']') == 1;
+  bytes += 2;
   file.close();
+  if (!ok || !LittleFS.rename(tmpPath, kRumorsPath)) {
+    LittleFS.remove(tmpPath);
+    return false;
+  }
   return true;
 }
 
+static bool saveRumorsLocked() {
+  if (!rumorsLoaded) {
+    logLine("[rumor] store was not loaded, not saving over it");
+    storeMetrics.saveFailures.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  int64_t startUs = esp_timer_get_time();
+  size_t bytes = 0;
+  bool ok = writeRumorsFileLocked(bytes);
+  storeMetrics.saveDuration.record(static_cast<uint32_t>(esp_timer_get_time() - startUs));
+  (ok ? storeMetrics.saves : storeMetrics.saveFailures).fetch_add(1, std::memory_order_relaxed);
+  storeMetrics.saveBytes.fetch_add(bytes, std::memory_order_relaxed);
+  return ok;
+}
+
 static bool loadRumors() {
   if (!LittleFS.begin(true)) {
     logLine("[rumor] LittleFS begin failed");
     return false;
   }
+  slipCacheBegin();
   if (!LittleFS.exists(kRumorsPath)) {
     if (!lockRumors(200)) {
       logLine("[rumor] mutex busy on init");
       return false;
     }
     rumors.clear();
+    rumorsLoaded = true;
     bool ok = saveRumorsLocked();
     unlockRumors();
     if (ok) {
@@ -127,12 +561,40 @@ static bool loadRumors() {
     return false;
   }
 
-  size_t size = file.size();
-  DynamicJsonDocument doc(size + 1024);
-  DeserializationError err = deserializeJson(doc, file);
+  // The array is read element by element for the same reason it is
+  // written that way.
+  std::vector<Rumor> loaded;
+  DynamicJsonDocument doc(kStoredRumorDocSize);
+  bool ok = file.find("[");
+  if (!ok) {
+    logLine("[rumor] rumors file is not a JSON array");
+  }
+  while (ok && isspace(file.peek())) {
+    file.read();
+  }
+  bool empty = ok && file.peek() == ']';
+  while (ok && !empty) {
+    size_t start = file.position();
+    Rumor rumor;
+    DeserializationError err = deserializeJson(doc, file);
+    if (err == DeserializationError::NoMemory) {
+      err = readLargeStoredRumor(file, start, rumor);
+    } else if (!err) {
+      readStoredRumor(doc.as<JsonObjectConst>(), rumor);
+    }
+    if (err) {
+      logEvent(kLogRumorParseFailed, static_cast<unsigned>(loaded.size()), err.c_str());
+      ok = false;
+      break;
+    }
+    refreshRumorJson(rumor);
+    loaded.push_back(rumor);
+    if (!file.findUntil(",", "]")) {
+      break;
+    }
+  }
   file.close();
-  if (err) {
-    Serial.printf("[rumor] JSON parse failed: %s\n", err.c_str());
+  if (!ok) {
     return false;
   }
 
@@ -140,26 +602,149 @@ static bool loadRumors() {
     logLine("[rumor] mutex busy while loading");
     return false;
   }
-  rumors.clear();
-  JsonArray arr = doc.as<JsonArray>();
-  for (JsonObject obj : arr) {
-    Rumor rumor;
-    rumor.id = obj["id"] | 0;
-    rumor.title = obj["title"] | "";
-    rumor.textNl = obj["text_nl"] | "";
-    rumor.textEn = obj["text_en"] | "";
-    rumor.people = obj["people"] | "";
-    rumor.active = obj["active"] | true;
-    rumor.maxPrints = obj["max_prints"] | kDefaultMaxPrints;
-    rumor.printedCount = obj["printed_count"] | 0;
-    rumors.push_back(rumor);
-  }
+  rumors.swap(loaded);
+  rumorsLoaded = true;
   unlockRumors();
-  Serial.printf("[rumor] loaded %u rumors\n", static_cast<unsigned>(rumors.size()));
+  logEvent(kLogRumorsLoaded, static_cast<unsigned>(rumors.size()));
+
+  return true;
+}
+
+static const char *triggerPolicyName(TriggerPolicy policy) {
+  switch (policy) {
+    case kPolicyDropOldest:
+      return "drop_oldest";
+    case kPolicyCoalesce:
+      return "coalesce";
+    default:
+      return "drop_newest";
+  }
+}
+
+static bool parseTriggerPolicy(const char *name, TriggerPolicy &policy) {
+  if (!name) {
+    return false;
+  }
+  if (strcmp(name, "drop_newest") == 0) {
+    policy = kPolicyDropNewest;
+  } else if (strcmp(name, "drop_oldest") == 0) {
+    policy = kPolicyDropOldest;
+  } else if (strcmp(name, "coalesce") == 0) {
+    policy = kPolicyCoalesce;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static MillConfig currentMillConfig() {
+  portENTER_CRITICAL(&millConfigMux);
+  MillConfig config = millConfig;
+  portEXIT_CRITICAL(&millConfigMux);
+  return config;
+}
+
+static void writeMillConfigJson(JsonObject obj, const MillConfig &config) {
+  obj["cooldown_ms"] = config.cooldownMs;
+  obj["queue_depth"] = config.queueDepth;
+  obj["policy"] = triggerPolicyName(config.policy);
+  obj["raster_slips"] = config.rasterSlips;
+  JsonArray millsArr = obj.createNestedArray("mills");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    JsonObject millObj = millsArr.createNestedObject();
+    millObj["name"] = kMillPins[i].name;
+    millObj["pool"] = config.pools[i];
+  }
+}
+
+// Applies the fields present in `src` on top of `config`. Leaves `config`
+// untouched and returns an error message if any field is out of range.
+static const char *parseMillConfig(const JsonVariantConst &src, MillConfig &config) {
+  MillConfig next = config;
+  if (src.containsKey("cooldown_ms")) {
+    if (!src["cooldown_ms"].is<uint32_t>() || src["cooldown_ms"].as<uint32_t>() > kMaxCooldownMs) {
+      return "cooldown_ms out of range";
+    }
+    next.cooldownMs = src["cooldown_ms"].as<uint32_t>();
+  }
+  if (src.containsKey("queue_depth")) {
+    uint32_t depth = src["queue_depth"] | 0;
+    if (depth < 1 || depth > kPrintQueueCapacity) {
+      return "queue_depth out of range";
+    }
+    next.queueDepth = depth;
+  }
+  if (src.containsKey("policy") && !parseTriggerPolicy(src["policy"].as<const char *>(), next.policy)) {
+    return "unknown policy";
+  }
+  if (src.containsKey("raster_slips")) {
+    if (!src["raster_slips"].is<bool>()) {
+      return "raster_slips must be true or false";
+    }
+    next.rasterSlips = src["raster_slips"].as<bool>();
+  }
+  if (src.containsKey("mills")) {
+    JsonArrayConst millsArr = src["mills"].as<JsonArrayConst>();
+    if (millsArr.isNull() || millsArr.size() > kMillCount) {
+      return "mills must be an array with one entry per mill";
+    }
+    for (size_t i = 0; i < millsArr.size(); ++i) {
+      JsonVariantConst millObj = millsArr[i];
+      if (!millObj.containsKey("pool")) {
+        continue;
+      }
+      const char *pool = millObj["pool"] | "";
+      if (strlen(pool) >= kPoolNameMax) {
+        return "pool name too long";
+      }
+      strncpy(next.pools[i], pool, kPoolNameMax);
+    }
+  }
+  config = next;
+  return nullptr;
+}
 
+static bool saveMillConfig(const MillConfig &config) {
+  DynamicJsonDocument doc(512);
+  writeMillConfigJson(doc.to<JsonObject>(), config);
+  File file = LittleFS.open(kConfigPath, "w");
+  if (!file) {
+    return false;
+  }
+  serializeJson(doc, file);
+  file.close();
   return true;
 }
 
+// Runs after loadRumors() has mounted LittleFS. A missing or broken file
+// leaves the compiled-in defaults in place.
+static void loadMillConfig() {
+  if (!LittleFS.exists(kConfigPath)) {
+    return;
+  }
+  File file = LittleFS.open(kConfigPath, "r");
+  if (!file) {
+    return;
+  }
+  DynamicJsonDocument doc(512);
+  DeserializationError err = deserializeJson(doc, file);
+  file.close();
+  if (err) {
+    logEvent(kLogConfigParseFailed, err.c_str());
+    return;
+  }
+  MillConfig config;
+  const char *error = parseMillConfig(doc.as<JsonVariantConst>(), config);
+  if (error) {
+    logEvent(kLogConfigIgnored, error);
+    return;
+  }
+  portENTER_CRITICAL(&millConfigMux);
+  millConfig = config;
+  portEXIT_CRITICAL(&millConfigMux);
+  logEvent(kLogConfigApplied, config.cooldownMs, config.queueDepth, triggerPolicyName(config.policy));
+}
+
 static String toLowerCopy(const String &input) {
   String out = input;
   out.toLowerCase();
@@ -189,12 +774,39 @@ static bool nameMatches(const Rumor &rumor, const String &needle) {
   return false;
 }
 
-static void sendJsonError(AsyncWebServerRequest *request, int code, const char *message) {
+static String jsonError(const char *message) {
   DynamicJsonDocument doc(256);
   doc["error"] = message;
   String payload;
   serializeJson(doc, payload);
-  request->send(code, "application/json", payload);
+  return payload;
+}
+
+// Body handlers answer on async_tcp, route handlers through their ApiRequest.
+static void sendJsonError(AsyncWebServerRequest *request, int code, const char *message) {
+  request->send(code, "application/json", jsonError(message));
+}
+
+static void sendJsonError(ApiRequest *request, int code, const char *message) {
+  request->send(code, "application/json", jsonError(message));
+}
+
+// True if every rumor field present in src has the right type. A field of
+// the wrong type would otherwise read as null and blank the rumor.
+static bool rumorFieldsValid(const JsonVariantConst &src) {
+  static const char *const kStringFields[] = {"title", "text_nl", "text_en", "people", "pool"};
+  for (const char *field : kStringFields) {
+    if (src.containsKey(field) && !src[field].is<const char *>()) {
+      return false;
+    }
+  }
+  if (src.containsKey("active") && !src["active"].is<bool>()) {
+    return false;
+  }
+  if (src.containsKey("max_prints") && !src["max_prints"].is<uint16_t>()) {
+    return false;
+  }
+  return true;
 }
 
 static bool parseRumorFromJson(const JsonVariantConst &src, Rumor &rumor, bool allowPartial) {
@@ -204,6 +816,9 @@ static bool parseRumorFromJson(const JsonVariantConst &src, Rumor &rumor, bool a
       return false;
     }
   }
+  if (!rumorFieldsValid(src)) {
+    return false;
+  }
 
   if (src.containsKey("title")) {
     rumor.title = (const char *)src["title"];
@@ -217,6 +832,10 @@ static bool parseRumorFromJson(const JsonVariantConst &src, Rumor &rumor, bool a
   if (src.containsKey("people")) {
     rumor.people = (const char *)src["people"];
   }
+  if (src.containsKey("pool")) {
+    rumor.pool = (const char *)src["pool"];
+    rumor.pool.trim();
+  }
   if (src.containsKey("active")) {
     rumor.active = src["active"].as<bool>();
   }
@@ -227,112 +846,403 @@ static bool parseRumorFromJson(const JsonVariantConst &src, Rumor &rumor, bool a
     }
     rumor.maxPrints = maxPrints;
   }
+  refreshRumorRevision(rumor);
   return true;
 }
 
-static void appendRumorJson(JsonArray arr, const Rumor &rumor) {
-  JsonObject obj = arr.createNestedObject();
-  obj["id"] = rumor.id;
-  obj["title"] = rumor.title;
-  obj["text_nl"] = rumor.textNl;
-  obj["text_en"] = rumor.textEn;
-  obj["people"] = rumor.people;
-  obj["active"] = rumor.active;
-  obj["max_prints"] = rumor.maxPrints;
-  obj["printed_count"] = rumor.printedCount;
+// Strong ETag for one view of the list: boot, store version and the filter
+// (matching is case-insensitive, so the lowered filter). The gzipped body is
+// a different representation and gets its own tag.
+static String rumorListEtag(uint32_t version, const String &nameFilter, bool gzip = false) {
+  uint32_t hash = 2166136261u;
+  String needle = toLowerCopy(nameFilter);
+  for (size_t i = 0; i < needle.length(); ++i) {
+    hash ^= static_cast<uint8_t>(needle[i]);
+    hash *= 16777619u;
+  }
+  char etag[40];
+  snprintf(etag, sizeof(etag), "\"%08x-%u-%08x%s\"", static_cast<unsigned>(bootId), static_cast<unsigned>(version),
+           static_cast<unsigned>(hash), gzip ? "-gz" : "");
+  return String(etag);
 }
 
-static void handleListRumors(AsyncWebServerRequest *request) {
-  String nameFilter;
-  if (request->hasParam("name")) {
-    nameFilter = request->getParam("name")->value();
-  }
+// Gzipped bodies that only depend on the store version: the unfiltered list
+// and the full resync of /api/rumors/changes (which is what a browser loads
+// on first sight or after a reboot). Each is built on the first gzip request
+// after a change and shared by every response until the next one. Guarded
+// by gzipCacheMutex, held while a stale copy is rebuilt so that two workers
+// asking at once compress it only once.
+enum GzipBodyKind : uint8_t {
+  kGzipList,
+  kGzipFullSync,
+  kGzipBodyCount,
+};
 
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
-    return;
+struct GzipBody {
+  uint32_t version = 0;
+  std::shared_ptr<const std::vector<uint8_t>> bytes;
+};
+
+static SemaphoreHandle_t gzipCacheMutex;
+static GzipBody gzipBodies[kGzipBodyCount];
+
+// Brings one cached body up to the current version. The fragments are
+// copied out under the store lock and compressed after it is released.
+// False when the store is busy or memory is short; the caller then sends
+// the body uncompressed.
+static bool refreshGzipBodyLocked(GzipBodyKind kind) {
+  GzipBody &body = gzipBodies[kind];
+  if (body.bytes && body.version == rumorsVersion.load(std::memory_order_acquire)) {
+    return true;
   }
+  // Responses still sending the old bytes hold their own reference.
+  body.bytes.reset();
 
-  DynamicJsonDocument doc(1024 + rumors.size() * 256);
-  JsonArray arr = doc.to<JsonArray>();
-  for (const auto &rumor : rumors) {
-    if (nameMatches(rumor, nameFilter)) {
-      appendRumorJson(arr, rumor);
+  if (!lockRumorsShared(kRequestLockWaitMs)) {
+    return false;
+  }
+  uint32_t version = rumorsVersion.load(std::memory_order_acquire);
+  char prefix[64] = "[";
+  if (kind == kGzipFullSync) {
+    snprintf(prefix, sizeof(prefix), "{\"boot\":\"%08x\",\"version\":%u,\"full\":true,\"rumors\":[",
+             static_cast<unsigned>(bootId), static_cast<unsigned>(version));
+  }
+  String raw;
+  bool ok = raw.reserve(rumorsJsonLengthLocked() + strlen(prefix) + 2);
+  if (ok) {
+    raw += prefix;
+    for (size_t i = 0; i < rumors.size(); ++i) {
+      if (i > 0) {
+        raw += ',';
+      }
+      raw += rumors[i].json;
     }
+    raw += kind == kGzipFullSync ? "]}" : "]";
+  }
+  unlockRumorsShared();
+  if (!ok) {
+    return false;
   }
-  unlockRumors();
 
-  AsyncResponseStream *response = request->beginResponseStream("application/json");
-  serializeJson(doc, *response);
-  request->send(response);
+  auto bytes = std::make_shared<std::vector<uint8_t>>();
+  std::unique_ptr<GzipWriter> writer(new (std::nothrow) GzipWriter(*bytes));
+  if (!writer) {
+    return false;
+  }
+  bytes->reserve(raw.length() / 2);
+  writer->write(raw);
+  writer->finish();
+  body.bytes = bytes;
+  body.version = version;
+  return true;
 }
 
-static void handleCreateRumor(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-  if (index == 0) {
-    request->_tempObject = new String();
+static bool acceptsGzip(ApiRequest *request) {
+  return request->hasHeader("Accept-Encoding") && request->header("Accept-Encoding").indexOf("gzip") >= 0;
+}
+
+// Sends a cached gzip body, refreshing it first. False, with nothing sent,
+// when it could not be built.
+static bool sendGzipBody(ApiRequest *request, GzipBodyKind kind) {
+  if (xSemaphoreTake(gzipCacheMutex, pdMS_TO_TICKS(kGzipCacheWaitMs)) != pdTRUE) {
+    return false;
   }
-  String *body = static_cast<String *>(request->_tempObject);
-  body->concat(reinterpret_cast<char *>(data), len);
-  if (index + len != total) {
-    return;
+  bool ok = refreshGzipBodyLocked(kind);
+  std::shared_ptr<const std::vector<uint8_t>> bytes = gzipBodies[kind].bytes;
+  uint32_t version = gzipBodies[kind].version;
+  xSemaphoreGive(gzipCacheMutex);
+  if (!ok) {
+    return false;
   }
 
-  DynamicJsonDocument doc(body->length() + 512);
-  DeserializationError err = deserializeJson(doc, *body);
-  delete body;
-  request->_tempObject = nullptr;
-  if (err) {
-    sendJsonError(request, 400, "invalid json");
-    return;
+  AsyncWebServerResponse *response =
+      request->beginResponse("application/json", bytes->size(), [bytes](uint8_t *buffer, size_t maxLen, size_t index) {
+        size_t n = std::min(maxLen, bytes->size() - index);
+        memcpy(buffer, bytes->data() + index, n);
+        return n;
+      });
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("Vary", "Accept-Encoding");
+  if (kind == kGzipList) {
+    response->addHeader("ETag", rumorListEtag(version, String(), true));
+    response->addHeader("Cache-Control", "no-cache");
+  } else {
+    response->addHeader("Cache-Control", "no-store");
   }
+  request->send(response);
+  return true;
+}
 
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
-    return;
+// Answered from the version alone: no lock, no rumor data touched.
+static bool sendRumorListNotModified(ApiRequest *request, const String &nameFilter, bool gzip) {
+  if (!request->hasHeader("If-None-Match")) {
+    return false;
   }
-
-  Rumor rumor;
-  rumor.id = nextRumorId();
-  rumor.maxPrints = kDefaultMaxPrints;
-  if (!parseRumorFromJson(doc.as<JsonVariantConst>(), rumor, false)) {
-    unlockRumors();
-    sendJsonError(request, 400, "missing fields");
-    return;
+  String etag = rumorListEtag(rumorsVersion.load(std::memory_order_acquire), nameFilter, gzip);
+  if (request->header("If-None-Match").indexOf(etag) < 0) {
+    return false;
   }
-  rumors.push_back(rumor);
-  saveRumorsLocked();
-  unlockRumors();
+  AsyncWebServerResponse *response = request->beginResponse(304);
+  response->addHeader("ETag", etag);
+  response->addHeader("Vary", "Accept-Encoding");
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+  return true;
+}
 
-  DynamicJsonDocument out(512);
-  JsonArray arr = out.to<JsonArray>();
-  appendRumorJson(arr, rumor);
-  String payload;
-  serializeJson(arr[0], payload);
-  request->send(201, "application/json", payload);
+// Runs on async_tcp: most list fetches are revalidations, which need no
+// worker. The rest go on to handleListRumors().
+static void handleListRumorsNotModified(ApiRequest *request, const ApiParams &) {
+  String nameFilter = request->param("name");
+  sendRumorListNotModified(request, nameFilter, nameFilter.length() == 0 && acceptsGzip(request));
 }
 
-static void handleUpdateRumor(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-  if (index == 0) {
-    request->_tempObject = new String();
+static void handleListRumors(ApiRequest *request, const ApiParams &) {
+  String nameFilter;
+  if (request->hasParam("name")) {
+    nameFilter = request->param("name");
+  }
+
+  // Only the full list is worth compressing (and caching).
+  bool gzip = nameFilter.length() == 0 && acceptsGzip(request);
+
+  // The version may have moved on while the request was queued.
+  if (sendRumorListNotModified(request, nameFilter, gzip)) {
+    return;
   }
-  String *body = static_cast<String *>(request->_tempObject);
-  body->concat(reinterpret_cast<char *>(data), len);
-  if (index + len != total) {
+
+  if (gzip && sendGzipBody(request, kGzipList)) {
+    return;
+  }
+
+  if (!lockRumorsSharedForRequest(request)) {
     return;
   }
+  // Read under the lock so the tag always describes the data sent with it.
+  String etag = rumorListEtag(rumorsVersion.load(std::memory_order_acquire), nameFilter);
+
+  // The body is the cached fragments joined up; the buffer is sized for
+  // the whole library up front so it never grows while being filled.
+  AsyncResponseStream *response = request->beginResponseStream("application/json", rumorsJsonLengthLocked() + 2);
+  response->print('[');
+  bool first = true;
+  for (const auto &rumor : rumors) {
+    if (nameMatches(rumor, nameFilter)) {
+      if (!first) {
+        response->print(',');
+      }
+      response->write(reinterpret_cast<const uint8_t *>(rumor.json.c_str()), rumor.json.length());
+      first = false;
+    }
+  }
+  response->print(']');
+  unlockRumorsShared();
+
+  // no-cache lets the browser keep the list but revalidate it with
+  // If-None-Match on every fetch().
+  response->addHeader("ETag", etag);
+  response->addHeader("Vary", "Accept-Encoding");
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+}
 
-  uint32_t rumorId = request->pathArg(0).toInt();
-  DynamicJsonDocument doc(body->length() + 512);
-  DeserializationError err = deserializeJson(doc, *body);
-  delete body;
-  request->_tempObject = nullptr;
+// Request bodies are collected into one malloc'd, NUL-terminated block in
+// _tempObject. The server free()s _tempObject when the request goes away,
+// as does the ApiRequest that takes it over, so an upload that is cut off
+// halfway cannot leak it. A body that is too big or does not fit the heap
+// is answered at its first piece, and the router drops the rest as it
+// arrives instead of buffering it.
+static bool collectBodyUpTo(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total,
+                            size_t limit) {
+  if (index == 0) {
+    if (total > limit) {
+      sendJsonError(request, 413, "body too large");
+      return false;
+    }
+    char *body = static_cast<char *>(malloc(total + 1));
+    if (!body) {
+      sendJsonError(request, 503, "out of memory");
+      return false;
+    }
+    body[total] = '\0';
+    request->_tempObject = body;
+  }
+  char *body = static_cast<char *>(request->_tempObject);
+  if (body && index + len <= total) {
+    memcpy(body + index, data, len);
+  }
+  return true;
+}
+
+static bool collectBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  return collectBodyUpTo(request, data, len, index, total, kMaxBodyBytes);
+}
+
+static bool collectBatchBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  return collectBodyUpTo(request, data, len, index, total, kMaxBatchBodyBytes);
+}
+
+// Runs once the whole body is in. Parses it in place, so the document only
+// holds the tree and its strings point into the body buffer. Sends the
+// error response itself and returns false on failure.
+static bool parseBody(ApiRequest *request, JsonDocument &doc) {
+  char *body = static_cast<char *>(request->body());
+  if (!body) {
+    sendJsonError(request, 400, "missing body");
+    return false;
+  }
+  DeserializationError err = deserializeJson(doc, body);
+  if (err == DeserializationError::NoMemory) {
+    sendJsonError(request, 413, "too many fields");
+    return false;
+  }
   if (err) {
     sendJsonError(request, 400, "invalid json");
+    return false;
+  }
+  return true;
+}
+
+// The version a changes request asks from, and whether the client got it
+// from this boot. `boot` gets this boot's id.
+static bool readChangesSince(ApiRequest *request, uint32_t &since, char (&boot)[9]) {
+  since = 0;
+  if (request->hasParam("since")) {
+    since = strtoul(request->param("since").c_str(), nullptr, 10);
+  }
+  snprintf(boot, sizeof(boot), "%08x", static_cast<unsigned>(bootId));
+  return request->hasParam("boot") && request->param("boot") == boot;
+}
+
+// Runs on async_tcp: a client that is already up to date, as most polls
+// are, is told so from the version alone. The rest go on to
+// handleRumorChanges().
+static void handleRumorChangesUpToDate(ApiRequest *request, const ApiParams &) {
+  uint32_t since;
+  char boot[9];
+  if (!readChangesSince(request, since, boot) || since != rumorsVersion.load(std::memory_order_acquire)) {
     return;
   }
+  char payload[96];
+  snprintf(payload, sizeof(payload), "{\"boot\":\"%s\",\"version\":%u,\"full\":false,\"rumors\":[],\"deleted\":[]}",
+           boot, static_cast<unsigned>(since));
+  AsyncWebServerResponse *response = request->beginResponse(200, "application/json", payload);
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
 
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
+// Changes since a version the client got from an earlier call: the current
+// state of every rumor touched since then, and the ids of those now gone.
+// Clients from another boot, or further behind than the change log reaches,
+// get the whole list with "full": true instead, gzipped from the cache when
+// the client takes it.
+static void handleRumorChanges(ApiRequest *request, const ApiParams &) {
+  uint32_t since;
+  char boot[9];
+  bool sameBoot = readChangesSince(request, since, boot);
+
+  if (!lockRumorsSharedForRequest(request)) {
+    return;
+  }
+  uint32_t version = rumorsVersion.load(std::memory_order_acquire);
+  bool full = !sameBoot || since > version || since < changeLogFloor;
+  std::vector<uint32_t> touched;
+  for (size_t i = 0; !full && i < kChangeLogSize; ++i) {
+    const RumorChange &change = changeLog[i];
+    if (change.version <= since) {
+      continue;
+    }
+    uint32_t rumorId = change.rumorId;
+    if (rumorId == 0) {
+      full = true;
+    } else if (std::find(touched.begin(), touched.end(), rumorId) == touched.end()) {
+      touched.push_back(rumorId);
+    }
+  }
+  if (full && acceptsGzip(request)) {
+    // The full resync is the same for every client at this version.
+    unlockRumorsShared();
+    if (sendGzipBody(request, kGzipFullSync)) {
+      return;
+    }
+    if (!lockRumorsSharedForRequest(request)) {
+      return;
+    }
+    version = rumorsVersion.load(std::memory_order_acquire);
+  }
+
+  AsyncResponseStream *response = request->beginResponseStream(
+      "application/json", (full ? rumorsJsonLengthLocked() : touched.size() * 256) + 128);
+  response->printf("{\"boot\":\"%s\",\"version\":%u,\"full\":%s,\"rumors\":[", boot,
+                   static_cast<unsigned>(version), full ? "true" : "false");
+  std::vector<uint32_t> deleted;
+  bool first = true;
+  for (size_t i = 0; i < (full ? rumors.size() : touched.size()); ++i) {
+    const Rumor *rumor = full ? &rumors[i] : findRumorLocked(touched[i]);
+    if (!rumor) {
+      deleted.push_back(touched[i]);
+      continue;
+    }
+    if (!first) {
+      response->print(',');
+    }
+    response->write(reinterpret_cast<const uint8_t *>(rumor->json.c_str()), rumor->json.length());
+    first = false;
+  }
+  unlockRumorsShared();
+  response->print(']');
+  if (!full) {
+    response->print(",\"deleted\":[");
+    for (size_t i = 0; i < deleted.size(); ++i) {
+      response->printf(i > 0 ? ",%u" : "%u", static_cast<unsigned>(deleted[i]));
+    }
+    response->print(']');
+  }
+  response->print('}');
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+static void handleCreateRumor(ApiRequest *request, const ApiParams &) {
+  StaticJsonDocument<kBodyDocSize> doc;
+  if (!parseBody(request, doc)) {
+    return;
+  }
+
+  if (!lockRumorsForRequest(request)) {
+    return;
+  }
+
+  Rumor rumor;
+  rumor.id = nextRumorId();
+  rumor.maxPrints = kDefaultMaxPrints;
+  if (!parseRumorFromJson(doc.as<JsonVariantConst>(), rumor, false)) {
+    unlockRumors();
+    sendJsonError(request, 400, "missing or invalid fields");
+    return;
+  }
+  if (!rumorFitsStore(rumor)) {
+    unlockRumors();
+    sendJsonError(request, 413, "rumor too large");
+    return;
+  }
+  rumors.push_back(rumor);
+  markRumorChangedLocked(rumor.id);
+  saveRumorsLocked();
+  String payload = rumors.back().json;
+  unlockRumors();
+
+  request->send(201, "application/json", payload);
+}
+
+static void handleUpdateRumor(ApiRequest *request, const ApiParams &params) {
+  uint32_t rumorId = params[0];
+  StaticJsonDocument<kBodyDocSize> doc;
+  if (!parseBody(request, doc)) {
+    return;
+  }
+
+  if (!lockRumorsForRequest(request)) {
     return;
   }
 
@@ -349,27 +1259,30 @@ static void handleUpdateRumor(AsyncWebServerRequest *request, uint8_t *data, siz
     return;
   }
 
-  if (!parseRumorFromJson(doc.as<JsonVariantConst>(), *target, true)) {
+  // Changed on a copy, so a refused update leaves the rumor as it was.
+  Rumor updated = *target;
+  if (!parseRumorFromJson(doc.as<JsonVariantConst>(), updated, true)) {
     unlockRumors();
-    sendJsonError(request, 400, "missing fields");
+    sendJsonError(request, 400, "missing or invalid fields");
     return;
   }
+  if (!rumorFitsStore(updated)) {
+    unlockRumors();
+    sendJsonError(request, 413, "rumor too large");
+    return;
+  }
+  *target = updated;
+  markRumorChangedLocked(target->id);
   saveRumorsLocked();
-  Rumor updated = *target;
+  String payload = target->json;
   unlockRumors();
 
-  String payload;
-  DynamicJsonDocument out(512);
-  JsonArray arr = out.to<JsonArray>();
-  appendRumorJson(arr, updated);
-  serializeJson(arr[0], payload);
   request->send(200, "application/json", payload);
 }
 
-static void handleDeleteRumor(AsyncWebServerRequest *request) {
-  uint32_t rumorId = request->pathArg(0).toInt();
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
+static void handleDeleteRumor(ApiRequest *request, const ApiParams &params) {
+  uint32_t rumorId = params[0];
+  if (!lockRumorsForRequest(request)) {
     return;
   }
 
@@ -382,9 +1295,13 @@ static void handleDeleteRumor(AsyncWebServerRequest *request) {
     }
   }
   if (removed) {
+    markRumorChangedLocked(rumorId);
     saveRumorsLocked();
   }
   unlockRumors();
+  if (removed) {
+    purgeSlipCache(rumorId);
+  }
 
   if (!removed) {
     sendJsonError(request, 404, "not found");
@@ -393,10 +1310,9 @@ static void handleDeleteRumor(AsyncWebServerRequest *request) {
   request->send(204);
 }
 
-static void handleResetRumor(AsyncWebServerRequest *request) {
-  uint32_t rumorId = request->pathArg(0).toInt();
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
+static void handleResetRumor(ApiRequest *request, const ApiParams &params) {
+  uint32_t rumorId = params[0];
+  if (!lockRumorsForRequest(request)) {
     return;
   }
 
@@ -414,38 +1330,762 @@ static void handleResetRumor(AsyncWebServerRequest *request) {
   }
 
   target->printedCount = 0;
+  markRumorChangedLocked(target->id);
   saveRumorsLocked();
   unlockRumors();
   request->send(204);
 }
 
-static void handleResetAllRumors(AsyncWebServerRequest *request) {
-  if (!lockRumors(500)) {
-    sendJsonError(request, 503, "busy");
+static void handleResetAllRumors(ApiRequest *request, const ApiParams &) {
+  if (!lockRumorsForRequest(request)) {
     return;
   }
   for (auto &rumor : rumors) {
     rumor.printedCount = 0;
   }
+  markRumorChangedLocked(0);
   saveRumorsLocked();
   unlockRumors();
   request->send(204);
 }
 
-static void setupRoutes() {
-  server.on("/api/rumors", HTTP_GET, handleListRumors);
+enum BatchOpKind : uint8_t {
+  kBatchUpdate,
+  kBatchDelete,
+  kBatchReset,
+};
+
+struct BatchOp {
+  BatchOpKind kind;
+  uint32_t rumorId;
+  JsonVariantConst fields;
+};
+
+static void sendBatchError(ApiRequest *request, int code, const char *message, size_t index) {
+  DynamicJsonDocument doc(256);
+  doc["error"] = message;
+  doc["index"] = index;
+  String payload;
+  serializeJson(doc, payload);
+  request->send(code, "application/json", payload);
+}
+
+static bool parseBatchOp(JsonVariantConst src, BatchOp &op) {
+  const char *kind = src["op"];
+  op.rumorId = src["id"] | 0;
+  op.fields = src;
+  if (!kind || op.rumorId == 0) {
+    return false;
+  }
+  if (strcmp(kind, "update") == 0) {
+    if (!rumorFieldsValid(src)) {
+      return false;
+    }
+    op.kind = kBatchUpdate;
+  } else if (strcmp(kind, "delete") == 0) {
+    op.kind = kBatchDelete;
+  } else if (strcmp(kind, "reset") == 0) {
+    op.kind = kBatchReset;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// PATCH /api/rumors: an array of {"op": "update"|"delete"|"reset", "id": n}
+// (updates carry the fields to change, as with PUT). Every operation is
+// checked before the first one is applied, so a batch either goes through
+// whole or not at all; errors name the index of the offending operation.
+// One lock, one save.
+static void handleBatchRumors(ApiRequest *request, const ApiParams &) {
+  DynamicJsonDocument doc(kBatchDocSize);
+  if (!parseBody(request, doc)) {
+    return;
+  }
+  JsonArrayConst list = doc.as<JsonArrayConst>();
+  if (list.isNull() || list.size() == 0) {
+    sendJsonError(request, 400, "expected an array of operations");
+    return;
+  }
+  if (list.size() > kMaxBatchOps) {
+    sendJsonError(request, 413, "too many operations");
+    return;
+  }
+  std::vector<BatchOp> ops(list.size());
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (!parseBatchOp(list[i], ops[i])) {
+      sendBatchError(request, 400, "invalid operation", i);
+      return;
+    }
+  }
+
+  if (!lockRumorsForRequest(request)) {
+    return;
+  }
+  // Updates are tried on copies first, in order, so several on one rumor
+  // are checked against the size cap together.
+  std::vector<uint32_t> deleted;
+  std::vector<Rumor> drafts;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    uint32_t rumorId = ops[i].rumorId;
+    const Rumor *stored = findRumorLocked(rumorId);
+    if (!stored || std::find(deleted.begin(), deleted.end(), rumorId) != deleted.end()) {
+      unlockRumors();
+      sendBatchError(request, 404, "not found", i);
+      return;
+    }
+    if (ops[i].kind == kBatchDelete) {
+      deleted.push_back(rumorId);
+    } else if (ops[i].kind == kBatchUpdate) {
+      auto draft = std::find_if(drafts.begin(), drafts.end(),
+                                [rumorId](const Rumor &rumor) { return rumor.id == rumorId; });
+      if (draft == drafts.end()) {
+        draft = drafts.insert(drafts.end(), *stored);
+      }
+      parseRumorFromJson(ops[i].fields, *draft, true);
+      if (!rumorFitsStore(*draft)) {
+        unlockRumors();
+        sendBatchError(request, 413, "rumor too large", i);
+        return;
+      }
+    }
+  }
+
+  std::vector<uint32_t> touched;
+  for (const auto &op : ops) {
+    if (std::find(touched.begin(), touched.end(), op.rumorId) == touched.end()) {
+      touched.push_back(op.rumorId);
+    }
+    if (op.kind == kBatchDelete) {
+      rumors.erase(std::find_if(rumors.begin(), rumors.end(),
+                                [&op](const Rumor &rumor) { return rumor.id == op.rumorId; }));
+    } else if (op.kind == kBatchReset) {
+      findRumorLocked(op.rumorId)->printedCount = 0;
+    } else {
+      parseRumorFromJson(op.fields, *findRumorLocked(op.rumorId), true);
+    }
+  }
+  // One version for the whole batch.
+  markRumorsChangedLocked(touched.data(), touched.size());
+  saveRumorsLocked();
+  uint32_t version = rumorsVersion.load(std::memory_order_acquire);
+  unlockRumors();
+  for (uint32_t rumorId : deleted) {
+    purgeSlipCache(rumorId);
+  }
+
+  DynamicJsonDocument out(128);
+  out["applied"] = ops.size();
+  out["version"] = version;
+  String payload;
+  serializeJson(out, payload);
+  request->send(200, "application/json", payload);
+}
+
+// Most rumors one import takes; they are all held in memory until the
+// batch is applied.
+static const size_t kMaxImportRumors = 500;
+
+// Most bytes of rumor JSON the library may hold after an import, taken
+// when the body starts. A full list or resync goes out of one buffer that
+// size, so it has to fit the largest free block, with the same again
+// left over for the parsed batch while it is applied.
+static size_t importBudget() {
+  return ESP.getMaxAllocHeap() / 2;
+}
+
+// NDJSON import state. Lines are parsed as they arrive, so only the current
+// line is buffered, and the rumors are applied together once the body is
+// in. It owns a vector, so the route deletes it once the request and its
+// handler are done with it instead of leaving it to a plain free().
+struct ImportState {
+  bool replace = false;
+  bool overflow = false;
+  size_t lineLength = 0;
+  size_t lineNumber = 0;
+  size_t budget = 0;
+  size_t bytes = 0;
+  const char *error = nullptr;
+  int errorCode = 400;
+  size_t errorLine = 0;
+  std::vector<Rumor> parsed;
+  char line[kMaxBodyBytes + 1];
+};
+
+static void importFail(ImportState &state, const char *error, int code = 400) {
+  state.error = error;
+  state.errorCode = code;
+  state.errorLine = state.lineNumber;
+  state.parsed.clear();
+}
+
+static void importLine(ImportState &state) {
+  ++state.lineNumber;
+  size_t length = state.lineLength;
+  bool overflow = state.overflow;
+  state.lineLength = 0;
+  state.overflow = false;
+  if (state.error) {
+    return;
+  }
+  if (overflow) {
+    importFail(state, "line too long");
+    return;
+  }
+  while (length > 0 && isspace(static_cast<unsigned char>(state.line[length - 1]))) {
+    --length;
+  }
+  if (length == 0) {
+    return;
+  }
+  if (state.parsed.size() == kMaxImportRumors) {
+    importFail(state, "too many rumors", 413);
+    return;
+  }
+
+  StaticJsonDocument<kBodyDocSize> doc;
+  DeserializationError err = deserializeJson(doc, state.line, length);
+  if (err || !doc.is<JsonObject>()) {
+    importFail(state, err == DeserializationError::NoMemory ? "too many fields" : "invalid json");
+    return;
+  }
+  Rumor rumor;
+  rumor.maxPrints = kDefaultMaxPrints;
+  if (!parseRumorFromJson(doc.as<JsonVariantConst>(), rumor, false)) {
+    importFail(state, "missing or invalid fields");
+    return;
+  }
+  size_t bytes = rumorJsonLength(rumor);
+  if (bytes > kMaxRumorBytes) {
+    importFail(state, "rumor too large", 413);
+    return;
+  }
+  state.bytes += bytes + 1;
+  if (state.bytes > state.budget) {
+    importFail(state, "import too large", 413);
+    return;
+  }
+  if (state.replace) {
+    // A restore keeps what the export recorded.
+    rumor.id = doc["id"] | 0;
+    rumor.printedCount = doc["printed_count"] | 0;
+  }
+  state.parsed.push_back(rumor);
+}
+
+static void releaseImport(void *body) {
+  delete static_cast<ImportState *>(body);
+}
+
+static bool collectImport(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (index == 0 && !request->_tempObject) {
+    ImportState *state = new (std::nothrow) ImportState();
+    if (!state) {
+      sendJsonError(request, 503, "out of memory");
+      return false;
+    }
+    state->replace = request->hasParam("replace") && request->getParam("replace")->value() == "1";
+    state->budget = importBudget();
+    request->_tempObject = state;
+  }
+  ImportState *state = static_cast<ImportState *>(request->_tempObject);
+  if (!state) {
+    return true;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    char c = static_cast<char>(data[i]);
+    if (c == '\n') {
+      importLine(*state);
+    } else if (state->lineLength < kMaxBodyBytes) {
+      state->line[state->lineLength++] = c;
+    } else {
+      state->overflow = true;
+    }
+  }
+  if (index + len == total && (state->lineLength > 0 || state->overflow)) {
+    importLine(*state);
+  }
+  return true;
+}
+
+// Replace mode keeps exported ids where they are unique; the rest get
+// fresh ones.
+static void assignImportIds(std::vector<Rumor> &batch, uint32_t firstFree) {
+  std::vector<uint32_t> used;
+  uint32_t maxId = firstFree > 0 ? firstFree - 1 : 0;
+  for (auto &rumor : batch) {
+    if (rumor.id != 0 && std::find(used.begin(), used.end(), rumor.id) == used.end()) {
+      used.push_back(rumor.id);
+      maxId = std::max(maxId, rumor.id);
+    } else {
+      rumor.id = 0;
+    }
+  }
+  for (auto &rumor : batch) {
+    if (rumor.id == 0) {
+      rumor.id = ++maxId;
+    }
+  }
+}
+
+// POST /api/rumors/import: one rumor per line, as written by the export.
+// Appends by default; ?replace=1 swaps in the batch as the whole library
+// (ids and print counts included), refused with a 409 while a slip is
+// printing. Nothing is applied unless every line is valid, and a batch that
+// would not fit the heap (see importBudget()) gets a 413. The body has to
+// go out as application/x-ndjson (or anything but form encoding, which the
+// server parses as parameters instead).
+static void handleImportRumors(ApiRequest *request, const ApiParams &) {
+  ImportState *state = static_cast<ImportState *>(request->body());
+  if (!state) {
+    sendJsonError(request, 400, "missing body");
+    return;
+  }
+  if (state->error) {
+    DynamicJsonDocument doc(256);
+    doc["error"] = state->error;
+    doc["line"] = state->errorLine;
+    String payload;
+    serializeJson(doc, payload);
+    request->send(state->errorCode, "application/json", payload);
+    return;
+  }
+  if (state->parsed.empty()) {
+    sendJsonError(request, 400, "no rumors");
+    return;
+  }
+
+  if (!lockRumorsForRequest(request)) {
+    return;
+  }
+  size_t imported = state->parsed.size();
+  if (state->replace) {
+    // A burst printing now commits its prints by id when it is done;
+    // those ids would name different rumors after the swap.
+    for (const auto &rumor : rumors) {
+      if (rumor.reservedCount > 0) {
+        unlockRumors();
+        sendJsonError(request, 409, "a slip is printing, try again shortly");
+        return;
+      }
+    }
+    assignImportIds(state->parsed, 1);
+    rumors.swap(state->parsed);
+  } else {
+    // Appending keeps the library, which the budget did not count.
+    if (rumorsJsonLengthLocked() + state->bytes > state->budget) {
+      unlockRumors();
+      sendJsonError(request, 413, "import too large");
+      return;
+    }
+    uint32_t rumorId = nextRumorId();
+    for (auto &rumor : state->parsed) {
+      rumor.id = rumorId++;
+      rumors.push_back(rumor);
+    }
+  }
+  markRumorChangedLocked(0);
+  bool saved = saveRumorsLocked();
+  size_t count = rumors.size();
+  unlockRumors();
+  if (state->replace) {
+    purgeSlipCache(0);
+  }
+  logEvent(kLogRumorsImported, static_cast<unsigned>(imported), state->replace ? ", replacing the library" : "",
+           saved ? "" : ", save failed");
+
+  DynamicJsonDocument doc(128);
+  doc["imported"] = imported;
+  doc["rumors"] = count;
+  String payload;
+  serializeJson(doc, payload);
+  request->send(200, "application/json", payload);
+}
 
-  server.on("/api/rumors", HTTP_POST, [](AsyncWebServerRequest *request) {},
-            nullptr, handleCreateRumor);
+// Export state: only the ids are taken up front. Each rumor's cached JSON
+// is copied under a short lock when the connection has room for it, so
+// memory stays at one line however big the library is. Rumors deleted
+// meanwhile are skipped. The filler runs on async_tcp, so it only tries
+// the lock and asks to be called again when the store is busy.
+struct ExportState {
+  std::vector<uint32_t> ids;
+  size_t next = 0;
+  String line;
+  size_t offset = 0;
+};
 
-  server.on("^\\/api\\/rumors\\/(\\d+)$", HTTP_PUT, [](AsyncWebServerRequest *request) {},
-            nullptr, handleUpdateRumor);
+static size_t fillExport(ExportState &state, uint8_t *buffer, size_t maxLen) {
+  size_t written = 0;
+  while (written < maxLen) {
+    if (state.offset == state.line.length()) {
+      if (state.next == state.ids.size()) {
+        break;
+      }
+      if (!lockRumorsShared(0)) {
+        return written > 0 ? written : RESPONSE_TRY_AGAIN;
+      }
+      state.line = "";
+      state.offset = 0;
+      const Rumor *rumor = findRumorLocked(state.ids[state.next++]);
+      if (!rumor) {
+        unlockRumorsShared();
+        continue;
+      }
+      state.line = rumor->json;
+      unlockRumorsShared();
+      state.line += '\n';
+    }
+    size_t n = std::min(maxLen - written, state.line.length() - state.offset);
+    memcpy(buffer + written, state.line.c_str() + state.offset, n);
+    written += n;
+    state.offset += n;
+  }
+  return written;
+}
 
-  server.on("^\\/api\\/rumors\\/(\\d+)$", HTTP_DELETE, handleDeleteRumor);
-  server.on("^\\/api\\/rumors\\/(\\d+)\\/reset$", HTTP_POST, handleResetRumor);
-  server.on("/api/rumors/resetAll", HTTP_POST, handleResetAllRumors);
+static void handleExportRumors(ApiRequest *request, const ApiParams &) {
+  auto state = std::make_shared<ExportState>();
+  if (!lockRumorsSharedForRequest(request)) {
+    return;
+  }
+  state->ids.reserve(rumors.size());
+  for (const auto &rumor : rumors) {
+    state->ids.push_back(rumor.id);
+  }
+  unlockRumorsShared();
+
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      "application/x-ndjson",
+      [state](uint8_t *buffer, size_t maxLen, size_t) -> size_t { return fillExport(*state, buffer, maxLen); });
+  response->addHeader("Content-Disposition", "attachment; filename=\"rumors.ndjson\"");
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+// Runs on async_tcp (see kApiRoutes): nothing here may wait.
+static void handleStatus(ApiRequest *request, const ApiParams &) {
+  uint32_t reserved = rumorsReserved.load(std::memory_order_relaxed);
+  MillConfig config = currentMillConfig();
+
+  DynamicJsonDocument doc(768 + kMillCount * 768);
+  JsonArray millsArr = doc.createNestedArray("mills");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    Mill &mill = *mills[i];
+    portENTER_CRITICAL(&printStatusMux);
+    PrinterStatus status = mill.status;
+    PrintStats stats = mill.stats;
+    TriggerStats triggers = mill.triggers;
+    portEXIT_CRITICAL(&printStatusMux);
+
+    JsonObject millObj = millsArr.createNestedObject();
+    millObj["name"] = mill.pins.name;
+    millObj["pool"] = config.pools[i];
+    JsonObject printerObj = millObj.createNestedObject("printer");
+    printerObj["online"] = status.online;
+    printerObj["paper"] = status.paper;
+    printerObj["overheated"] = status.overheated;
+    printerObj["checked_ms_ago"] = status.checkedAt ? millis() - status.checkedAt : 0;
+    JsonObject jobsObj = millObj.createNestedObject("jobs");
+    jobsObj["printed"] = stats.printed;
+    jobsObj["failed"] = stats.failed;
+    jobsObj["retries"] = stats.retries;
+    jobsObj["queued"] = uxQueueMessagesWaiting(mill.queue);
+    if (stats.lastError) {
+      jobsObj["last_error"] = stats.lastError;
+      jobsObj["last_error_ms_ago"] = millis() - stats.lastErrorAt;
+    }
+    if (stats.latencySamples) {
+      JsonObject latencyObj = jobsObj.createNestedObject("trigger_latency_ms");
+      latencyObj["last"] = stats.lastLatencyMs;
+      latencyObj["avg"] = static_cast<uint32_t>(stats.latencySumMs / stats.latencySamples);
+      latencyObj["max"] = stats.maxLatencyMs;
+      latencyObj["samples"] = stats.latencySamples;
+    }
+    JsonObject triggersObj = millObj.createNestedObject("triggers");
+    triggersObj["accepted"] = triggers.accepted;
+    triggersObj["rejected_cooldown"] = triggers.rejectedCooldown;
+    triggersObj["dropped"] = triggers.dropped;
+    triggersObj["coalesced"] = triggers.coalesced;
+  }
+  doc["reserved"] = reserved;
+  JsonObject powerObj = doc.createNestedObject("power");
+  powerObj["low_power"] = RUMOURMILL_LOW_POWER != 0;
+  powerObj["light_sleep"] = lightSleepEnabled;
+  String payload;
+  serializeJson(doc, payload);
+  request->send(200, "application/json", payload);
+}
+
+static void handleGetConfig(ApiRequest *request, const ApiParams &) {
+  DynamicJsonDocument doc(512);
+  writeMillConfigJson(doc.to<JsonObject>(), currentMillConfig());
+  String payload;
+  serializeJson(doc, payload);
+  request->send(200, "application/json", payload);
+}
+
+// Partial update; only the fields sent are changed. Takes effect on the next
+// trigger, no reboot needed.
+static void handleUpdateConfig(ApiRequest *request, const ApiParams &) {
+  StaticJsonDocument<kBodyDocSize> doc;
+  if (!parseBody(request, doc)) {
+    return;
+  }
+
+  MillConfig config = currentMillConfig();
+  const char *error = parseMillConfig(doc.as<JsonVariantConst>(), config);
+  if (error) {
+    sendJsonError(request, 400, error);
+    return;
+  }
+  portENTER_CRITICAL(&millConfigMux);
+  millConfig = config;
+  portEXIT_CRITICAL(&millConfigMux);
+  if (!saveMillConfig(config)) {
+    logLine("[config] failed to persist config");
+  }
+  logEvent(kLogConfigApplied, config.cooldownMs, config.queueDepth, triggerPolicyName(config.policy));
 
-  server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
+  DynamicJsonDocument out(512);
+  writeMillConfigJson(out.to<JsonObject>(), config);
+  String payload;
+  serializeJson(out, payload);
+  request->send(200, "application/json", payload);
+}
+
+static void printTraceSummary(Print &out, const char *stage, const TraceSummary &summary) {
+  out.printf("{\"stage\":\"%s\",\"count\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}", stage,
+             summary.count, summary.p50Us, summary.p90Us, summary.p99Us, summary.maxUs);
+}
+
+// The trace ring as JSON: per-stage percentiles (time since the previous
+// stage of the same job), reed edge to job done, and the raw events unless
+// ?events=0. Streamed because the full ring is too big for a JSON document.
+static void handleTrace(ApiRequest *request, const ApiParams &) {
+  std::vector<TraceEvent> events(kTraceCapacity);
+  size_t count = traceSnapshot(events.data(), events.size());
+  TraceSummary stages[kTraceStageCount];
+  TraceSummary total;
+  traceSummarize(events.data(), count, stages, total);
+  bool withEvents = !request->hasParam("events") || request->param("events") != "0";
+
+  AsyncResponseStream *response = request->beginResponseStream("application/json");
+  response->print("{\"stages\":[");
+  for (uint8_t stage = kTraceReedEdge + 1; stage < kTraceStageCount; ++stage) {
+    if (stage > kTraceReedEdge + 1) {
+      response->print(",");
+    }
+    printTraceSummary(*response, traceStageName(stage), stages[stage]);
+  }
+  response->print("],\"total\":");
+  printTraceSummary(*response, "reed_edge_to_job_done", total);
+  if (withEvents) {
+    // [seq, t_us, job, mill, stage]
+    response->print(",\"events\":[");
+    for (size_t i = 0; i < count; ++i) {
+      const TraceEvent &event = events[i];
+      response->printf("%s[%u,%u,%u,%u,\"%s\"]", i ? "," : "", event.seq, event.atUs, event.job, event.mill,
+                       traceStageName(event.stage));
+    }
+    response->print("]");
+  }
+  response->print("}");
+  request->send(response);
+}
+
+// Defined below the router, whose per-route numbers it reports.
+static void handleMetrics(ApiRequest *request, const ApiParams &);
+
+// {method, path, on async_tcp, on a worker, body, body release}. What only
+// reads atomics, snapshots or the version runs on async_tcp; what waits on
+// the store lock or flash goes to a worker.
+static const ApiRoute kApiRoutes[] = {
+    {HTTP_GET, "/api/status", handleStatus, nullptr},
+    {HTTP_GET, "/api/metrics", handleMetrics, nullptr},
+    {HTTP_GET, "/api/trace", handleTrace, nullptr},
+    {HTTP_GET, "/api/config", handleGetConfig, nullptr},
+    {HTTP_PUT, "/api/config", nullptr, handleUpdateConfig, collectBody},
+    {HTTP_GET, "/api/rumors", handleListRumorsNotModified, handleListRumors},
+    {HTTP_POST, "/api/rumors", nullptr, handleCreateRumor, collectBody},
+    {HTTP_PATCH, "/api/rumors", nullptr, handleBatchRumors, collectBatchBody},
+    {HTTP_GET, "/api/rumors/changes", handleRumorChangesUpToDate, handleRumorChanges},
+    {HTTP_GET, "/api/rumors/export", nullptr, handleExportRumors},
+    {HTTP_POST, "/api/rumors/import", nullptr, handleImportRumors, collectImport, releaseImport},
+    {HTTP_POST, "/api/rumors/resetAll", nullptr, handleResetAllRumors},
+    {HTTP_PUT, "/api/rumors/{id}", nullptr, handleUpdateRumor, collectBody},
+    {HTTP_DELETE, "/api/rumors/{id}", nullptr, handleDeleteRumor},
+    {HTTP_POST, "/api/rumors/{id}/reset", nullptr, handleResetRumor},
+};
+static ApiRouter apiRouter(kApiRoutes, sizeof(kApiRoutes) / sizeof(kApiRoutes[0]));
+
+struct MillMetrics {
+  PrintStats stats;
+  TriggerStats triggers;
+  uint32_t queued;
+};
+
+static MillMetrics millMetrics(Mill &mill) {
+  MillMetrics metrics;
+  portENTER_CRITICAL(&printStatusMux);
+  metrics.stats = mill.stats;
+  metrics.triggers = mill.triggers;
+  portEXIT_CRITICAL(&printStatusMux);
+  metrics.queued = uxQueueMessagesWaiting(mill.queue);
+  return metrics;
+}
+
+static void printPrometheusMetrics(Print &out) {
+  out.printf("# TYPE rumourmill_uptime_seconds gauge\nrumourmill_uptime_seconds %u\n",
+             static_cast<unsigned>(esp_timer_get_time() / 1000000));
+  out.printf("# TYPE rumourmill_heap_free_bytes gauge\nrumourmill_heap_free_bytes %u\n",
+             static_cast<unsigned>(ESP.getFreeHeap()));
+  out.printf("# TYPE rumourmill_heap_min_free_bytes gauge\nrumourmill_heap_min_free_bytes %u\n",
+             static_cast<unsigned>(ESP.getMinFreeHeap()));
+  out.printf("# TYPE rumourmill_heap_largest_block_bytes gauge\nrumourmill_heap_largest_block_bytes %u\n",
+             static_cast<unsigned>(ESP.getMaxAllocHeap()));
+
+  char labels[96];
+  out.print("# TYPE rumourmill_api_requests_total counter\n");
+  for (size_t i = 0; i < apiRouter.routeCount(); ++i) {
+    const ApiRoute &route = apiRouter.route(i);
+    out.printf("rumourmill_api_requests_total{method=\"%s\",route=\"%s\"} %u\n", apiMethodName(route.method),
+               route.path, static_cast<unsigned>(apiRouter.routeMetrics(i).requests.load(std::memory_order_relaxed)));
+  }
+  out.print("# TYPE rumourmill_api_request_duration_seconds histogram\n");
+  for (size_t i = 0; i < apiRouter.routeCount(); ++i) {
+    const ApiRoute &route = apiRouter.route(i);
+    snprintf(labels, sizeof(labels), "method=\"%s\",route=\"%s\"", apiMethodName(route.method), route.path);
+    metricPrometheusHistogram(out, "rumourmill_api_request_duration_seconds", labels, apiRouter.routeMetrics(i).latency);
+  }
+  out.print("# TYPE rumourmill_api_queue_wait_seconds histogram\n");
+  metricPrometheusHistogram(out, "rumourmill_api_queue_wait_seconds", "", apiRouter.queueWait());
+  out.printf("# TYPE rumourmill_api_busy_total counter\nrumourmill_api_busy_total %u\n",
+             static_cast<unsigned>(apiBusyCount()));
+
+  out.print("# TYPE rumourmill_store_lock_wait_seconds histogram\n");
+  metricPrometheusHistogram(out, "rumourmill_store_lock_wait_seconds", "mode=\"shared\"", storeMetrics.lockWaitShared);
+  metricPrometheusHistogram(out, "rumourmill_store_lock_wait_seconds", "mode=\"exclusive\"",
+                            storeMetrics.lockWaitExclusive);
+  out.print("# TYPE rumourmill_store_lock_hold_seconds histogram\n");
+  metricPrometheusHistogram(out, "rumourmill_store_lock_hold_seconds", "mode=\"exclusive\"",
+                            storeMetrics.lockHoldExclusive);
+  out.print("# TYPE rumourmill_store_save_duration_seconds histogram\n");
+  metricPrometheusHistogram(out, "rumourmill_store_save_duration_seconds", "", storeMetrics.saveDuration);
+  out.printf("# TYPE rumourmill_store_saves_total counter\nrumourmill_store_saves_total %u\n",
+             static_cast<unsigned>(storeMetrics.saves.load(std::memory_order_relaxed)));
+  out.printf("# TYPE rumourmill_store_save_failures_total counter\nrumourmill_store_save_failures_total %u\n",
+             static_cast<unsigned>(storeMetrics.saveFailures.load(std::memory_order_relaxed)));
+  out.printf("# TYPE rumourmill_store_save_bytes_total counter\nrumourmill_store_save_bytes_total %u\n",
+             static_cast<unsigned>(storeMetrics.saveBytes.load(std::memory_order_relaxed)));
+
+  MillMetrics metrics[kMillCount];
+  for (size_t i = 0; i < kMillCount; ++i) {
+    metrics[i] = millMetrics(*mills[i]);
+  }
+  out.print("# TYPE rumourmill_prints_total counter\n");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    out.printf("rumourmill_prints_total{mill=\"%s\"} %u\n", kMillPins[i].name,
+               static_cast<unsigned>(metrics[i].stats.printed));
+  }
+  out.print("# TYPE rumourmill_print_failures_total counter\n");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    out.printf("rumourmill_print_failures_total{mill=\"%s\"} %u\n", kMillPins[i].name,
+               static_cast<unsigned>(metrics[i].stats.failed));
+  }
+  out.print("# TYPE rumourmill_print_retries_total counter\n");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    out.printf("rumourmill_print_retries_total{mill=\"%s\"} %u\n", kMillPins[i].name,
+               static_cast<unsigned>(metrics[i].stats.retries));
+  }
+  out.print("# TYPE rumourmill_print_queue_length gauge\n");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    out.printf("rumourmill_print_queue_length{mill=\"%s\"} %u\n", kMillPins[i].name,
+               static_cast<unsigned>(metrics[i].queued));
+  }
+  out.print("# TYPE rumourmill_triggers_total counter\n");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    const TriggerStats &triggers = metrics[i].triggers;
+    const char *name = kMillPins[i].name;
+    out.printf("rumourmill_triggers_total{mill=\"%s\",result=\"accepted\"} %u\n", name,
+               static_cast<unsigned>(triggers.accepted));
+    out.printf("rumourmill_triggers_total{mill=\"%s\",result=\"rejected_cooldown\"} %u\n", name,
+               static_cast<unsigned>(triggers.rejectedCooldown));
+    out.printf("rumourmill_triggers_total{mill=\"%s\",result=\"dropped\"} %u\n", name,
+               static_cast<unsigned>(triggers.dropped));
+    out.printf("rumourmill_triggers_total{mill=\"%s\",result=\"coalesced\"} %u\n", name,
+               static_cast<unsigned>(triggers.coalesced));
+  }
+}
+
+static void printJsonMetrics(Print &out) {
+  out.printf("{\"uptime_s\":%u,\"heap\":{\"free\":%u,\"min_free\":%u,\"largest_block\":%u},\"buckets_us\":[",
+             static_cast<unsigned>(esp_timer_get_time() / 1000000), static_cast<unsigned>(ESP.getFreeHeap()),
+             static_cast<unsigned>(ESP.getMinFreeHeap()), static_cast<unsigned>(ESP.getMaxAllocHeap()));
+  for (size_t i = 0; i < kMetricBucketCount - 1; ++i) {
+    out.printf(i > 0 ? ",%u" : "%u", static_cast<unsigned>(kMetricBucketsUs[i]));
+  }
+  out.printf("],\"api\":{\"busy\":%u,\"queue_wait\":", static_cast<unsigned>(apiBusyCount()));
+  metricJsonHistogram(out, apiRouter.queueWait());
+  out.print(",\"routes\":[");
+  for (size_t i = 0; i < apiRouter.routeCount(); ++i) {
+    const ApiRoute &route = apiRouter.route(i);
+    const ApiRouteMetrics &metrics = apiRouter.routeMetrics(i);
+    out.printf("%s{\"method\":\"%s\",\"path\":\"%s\",\"requests\":%u,\"latency\":", i > 0 ? "," : "",
+               apiMethodName(route.method), route.path,
+               static_cast<unsigned>(metrics.requests.load(std::memory_order_relaxed)));
+    metricJsonHistogram(out, metrics.latency);
+    out.print("}");
+  }
+  out.print("]},\"store\":{\"lock_wait_shared\":");
+  metricJsonHistogram(out, storeMetrics.lockWaitShared);
+  out.print(",\"lock_wait_exclusive\":");
+  metricJsonHistogram(out, storeMetrics.lockWaitExclusive);
+  out.print(",\"lock_hold_exclusive\":");
+  metricJsonHistogram(out, storeMetrics.lockHoldExclusive);
+  out.print(",\"save_duration\":");
+  metricJsonHistogram(out, storeMetrics.saveDuration);
+  out.printf(",\"saves\":%u,\"save_failures\":%u,\"save_bytes\":%u},\"mills\":[",
+             static_cast<unsigned>(storeMetrics.saves.load(std::memory_order_relaxed)),
+             static_cast<unsigned>(storeMetrics.saveFailures.load(std::memory_order_relaxed)),
+             static_cast<unsigned>(storeMetrics.saveBytes.load(std::memory_order_relaxed)));
+  for (size_t i = 0; i < kMillCount; ++i) {
+    MillMetrics metrics = millMetrics(*mills[i]);
+    out.printf("%s{\"name\":\"%s\",\"printed\":%u,\"failed\":%u,\"retries\":%u,\"queued\":%u,"
+               "\"triggers\":{\"accepted\":%u,\"rejected_cooldown\":%u,\"dropped\":%u,\"coalesced\":%u}}",
+               i > 0 ? "," : "", kMillPins[i].name, static_cast<unsigned>(metrics.stats.printed),
+               static_cast<unsigned>(metrics.stats.failed), static_cast<unsigned>(metrics.stats.retries),
+               static_cast<unsigned>(metrics.queued), static_cast<unsigned>(metrics.triggers.accepted),
+               static_cast<unsigned>(metrics.triggers.rejectedCooldown),
+               static_cast<unsigned>(metrics.triggers.dropped), static_cast<unsigned>(metrics.triggers.coalesced));
+  }
+  out.print("]}");
+}
+
+// Prometheus text by default, ?format=json for the same numbers as JSON
+// (histogram buckets there are per bucket, not cumulative).
+static void handleMetrics(ApiRequest *request, const ApiParams &) {
+  bool json = request->hasParam("format") && request->param("format") == "json";
+  AsyncResponseStream *response =
+      request->beginResponseStream(json ? "application/json" : "text/plain; version=0.0.4", 8192);
+  if (json) {
+    printJsonMetrics(*response);
+  } else {
+    printPrometheusMetrics(*response);
+  }
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
+
+static void setupRoutes() {
+  server.addHandler(&events);
+  server.addHandler(&apiRouter);
+
+  // scripts/build_data.py gzips the web assets and names them after their
+  // contents, so they never change under a URL and can be cached for good.
+  // The server picks up the .gz files and sets Content-Encoding itself.
+  server.serveStatic("/assets/", LittleFS, "/assets/").setCacheControl("public, max-age=31536000, immutable");
+  // index.html names the current assets, so browsers revalidate it.
+  server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html").setCacheControl("no-cache");
   server.onNotFound([](AsyncWebServerRequest *request) {
     if (request->method() == HTTP_GET) {
       request->send(LittleFS, "/index.html", "text/html");
@@ -455,12 +2095,15 @@ static void setupRoutes() {
   });
 }
 
-static void printStart() {
+static void printStart(Mill &mill) {
+  Adafruit_Thermal &printer = mill.printer;
   printer.boldOn();
   printer.feed(2);
   delay(10);
   printer.println("Rumour Mill");
   delay(10);
+  printer.println(mill.pins.name);
+  delay(10);
   printer.println("Connect to:");
   delay(10);
   printer.println(kApSsid);
@@ -471,135 +2114,560 @@ static void printStart() {
   delay(10);
   printer.feed(4);
   delay(10);
-  printer.sleep();
-  delay(1000);
-  printer.wake();
 }
 
-static void printRumor(const Rumor &rumor) {
-  printer.boldOn();
-  printer.feed(2);
-  delay(10);
-  printer.println(rumor.textNl);
-  delay(10);
-  printer.println(rumor.textEn);
-  delay(10);
-  printer.feed(10);
-  delay(10);
-  printer.sleep();
-  delay(1000);
-  printer.wake();
+// Status query (ESC v 0) over the mill's UART RX. The printer answers once it
+// has worked through everything queued before it, so a reply after a job
+// means the job has left the print head.
+static PrinterStatus queryPrinterStatus(Mill &mill, uint32_t timeoutMs) {
+  HardwareSerial &uart = *mill.pins.uart;
+  while (uart.available()) {
+    uart.read();
+  }
+  mill.printer.writeBytes(27, 'v', 0);
+
+  PrinterStatus status;
+  uint32_t start = millis();
+  while (millis() - start < timeoutMs) {
+    if (uart.available()) {
+      uint8_t reply = uart.read();
+      status.online = true;
+      status.paper = (reply & 0x04) == 0;
+      status.overheated = (reply & 0x40) != 0;
+      break;
+    }
+    delay(10);
+  }
+  status.checkedAt = millis();
+
+  portENTER_CRITICAL(&printStatusMux);
+  mill.status = status;
+  portEXIT_CRITICAL(&printStatusMux);
+  return status;
 }
 
-static bool pickRandomRumor(Rumor &selected) {
+static const char *describePrinterFault(const PrinterStatus &status) {
+  if (!status.online) {
+    return "printer offline";
+  }
+  if (!status.paper) {
+    return "out of paper";
+  }
+  if (status.overheated) {
+    return "print head overheated";
+  }
+  return "unknown printer fault";
+}
+
+static void recordPrintsConfirmed(Mill &mill, size_t count) {
+  portENTER_CRITICAL(&printStatusMux);
+  mill.stats.printed += count;
+  portEXIT_CRITICAL(&printStatusMux);
+}
+
+static void recordPrintError(Mill &mill, const char *error) {
+  portENTER_CRITICAL(&printStatusMux);
+  mill.stats.lastError = error;
+  mill.stats.lastErrorAt = millis();
+  portEXIT_CRITICAL(&printStatusMux);
+}
+
+static void recordPrintRetry(Mill &mill) {
+  portENTER_CRITICAL(&printStatusMux);
+  mill.stats.retries += 1;
+  portEXIT_CRITICAL(&printStatusMux);
+}
+
+static void recordPrintFailure(Mill &mill) {
+  portENTER_CRITICAL(&printStatusMux);
+  mill.stats.failed += 1;
+  portEXIT_CRITICAL(&printStatusMux);
+}
+
+static void recordTriggerLatency(Mill &mill, int64_t edgeUs) {
+  uint32_t latencyMs = static_cast<uint32_t>((esp_timer_get_time() - edgeUs) / 1000);
+  portENTER_CRITICAL(&printStatusMux);
+  mill.stats.lastLatencyMs = latencyMs;
+  if (latencyMs > mill.stats.maxLatencyMs) {
+    mill.stats.maxLatencyMs = latencyMs;
+  }
+  mill.stats.latencySumMs += latencyMs;
+  mill.stats.latencySamples += 1;
+  portEXIT_CRITICAL(&printStatusMux);
+}
+
+enum PickResult : uint8_t {
+  kPickReserved,
+  kPickNoRumors,
+  // The store stayed locked (a save, an API write); try again.
+  kPickBusy,
+};
+
+// Picks up to `count` eligible rumors from `pool` (any pool when empty) in
+// one locked pass and holds one print of each. Nothing is persisted until
+// commitRumorPrints() confirms the slips actually came out. `mill` and `job`
+// only tag the trace.
+static PickResult reserveRandomRumors(size_t count, const char *pool, uint8_t mill, uint16_t job,
+                                      std::vector<Rumor> &selected) {
+  selected.clear();
   if (!lockRumors(500)) {
-    return false;
+    return kPickBusy;
   }
+  traceRecord(kTraceLockAcquired, job, mill);
   std::vector<size_t> eligible;
-  for (size_t i = 0; i < rumors.size(); ++i) {
-    const auto &rumor = rumors[i];
-    if (!rumor.active) {
-      continue;
+  for (size_t n = 0; n < count; ++n) {
+    eligible.clear();
+    for (size_t i = 0; i < rumors.size(); ++i) {
+      const auto &rumor = rumors[i];
+      if (!rumor.active) {
+        continue;
+      }
+      if (pool[0] != '\0' && rumor.pool != pool) {
+        continue;
+      }
+      if (rumor.printedCount + rumor.reservedCount >= rumor.maxPrints) {
+        continue;
+      }
+      eligible.push_back(i);
+    }
+    if (eligible.empty()) {
+      break;
     }
-    if (rumor.printedCount >= rumor.maxPrints) {
+    size_t choice = eligible[random(eligible.size())];
+    rumors[choice].reservedCount += 1;
+    selected.push_back(rumors[choice]);
+  }
+  rumorsReserved.fetch_add(selected.size(), std::memory_order_relaxed);
+  unlockRumors();
+  return selected.empty() ? kPickNoRumors : kPickReserved;
+}
+
+// Commit and release run on the print task, which can afford to wait: a
+// reservation that is never settled would hold back its rumor's prints for
+// good, so they keep trying until they get the store.
+static void commitRumorPrints(const std::vector<Rumor> &batch) {
+  while (!lockRumors(2000)) {
+    logLine("[print] store busy, still waiting to commit print counts");
+  }
+  bool changed = false;
+  for (const auto &printed : batch) {
+    Rumor *target = findRumorLocked(printed.id);
+    if (!target) {
       continue;
     }
-    eligible.push_back(i);
+    if (target->reservedCount > 0) {
+      target->reservedCount -= 1;
+    }
+    target->printedCount += 1;
+    markRumorChangedLocked(target->id);
+    changed = true;
   }
-  if (eligible.empty()) {
-    unlockRumors();
-    return false;
+  if (changed) {
+    saveRumorsLocked();
   }
+  rumorsReserved.fetch_sub(batch.size(), std::memory_order_relaxed);
+  unlockRumors();
+}
 
-  size_t choice = eligible[random(eligible.size())];
-  rumors[choice].printedCount += 1;
-  selected = rumors[choice];
-  saveRumorsLocked();
+static void releaseRumorReservations(const std::vector<Rumor> &batch) {
+  while (!lockRumors(2000)) {
+    logLine("[print] store busy, still waiting to release reservations");
+  }
+  for (const auto &reserved : batch) {
+    Rumor *target = findRumorLocked(reserved.id);
+    if (target && target->reservedCount > 0) {
+      target->reservedCount -= 1;
+    }
+  }
+  rumorsReserved.fetch_sub(batch.size(), std::memory_order_relaxed);
   unlockRumors();
-  return true;
 }
 
+// Runs a burst of triggers through one mill's printer: check status, reserve
+// one rumor per trigger, print them as one stream, confirm, then commit or
+// roll back the whole burst with a single save. Faults are retried a few
+// times before the burst is reported as failed on /api/status. `first` is
+// the oldest trigger in the burst; the burst is traced under its job.
+static void runPrintBurst(Mill &mill, size_t triggers, const PrintTrigger &first) {
+  const char *name = mill.pins.name;
+  uint16_t job = first.job;
+  MillConfig config = currentMillConfig();
+  const char *pool = config.pools[mill.index];
+  mill.slips.setRasterSlips(config.rasterSlips);
+  std::vector<Rumor> batch;
+  for (uint8_t attempt = 1; attempt <= kPrintMaxAttempts; ++attempt) {
+    if (attempt > 1) {
+      recordPrintRetry(mill);
+      vTaskDelay(pdMS_TO_TICKS(kPrintRetryDelayMs));
+    }
+
+    PrinterStatus before = queryPrinterStatus(mill, kPrinterStatusTimeoutMs);
+    if (!before.ready()) {
+      const char *error = describePrinterFault(before);
+      logEvent(kLogPrintAttemptFailed, name, attempt, error);
+      recordPrintError(mill, error);
+      continue;
+    }
+
+    PickResult picked = reserveRandomRumors(triggers, pool, mill.index, job, batch);
+    traceRecord(kTracePickDone, job, mill.index);
+    if (picked == kPickBusy) {
+      // Not the printer's fault; just try again after the retry delay.
+      logEvent(kLogPrintAttemptFailed, name, attempt, "store busy");
+      continue;
+    }
+    if (picked == kPickNoRumors) {
+      logEvent(kLogPrintNoRumors, name);
+      recordTriggerLatency(mill, first.edgeUs);
+      traceRecord(kTraceFirstByte, job, mill.index);
+      mill.slips.printNoRumors();
+      traceRecord(kTraceJobDone, job, mill.index);
+      return;
+    }
+
+    for (const auto &rumor : batch) {
+      logEvent(kLogPrintRumor, name, rumor.id, rumor.title);
+    }
+    if (attempt == 1) {
+      recordTriggerLatency(mill, first.edgeUs);
+    }
+    traceRecord(kTraceFirstByte, job, mill.index);
+    mill.slips.printRumors(batch);
+
+    PrinterStatus after = queryPrinterStatus(mill, kPrintConfirmTimeoutMs);
+    if (after.ready()) {
+      traceRecord(kTracePrinted, job, mill.index);
+      commitRumorPrints(batch);
+      traceRecord(kTraceSaved, job, mill.index);
+      recordPrintsConfirmed(mill, batch.size());
+      traceRecord(kTraceJobDone, job, mill.index);
+      return;
+    }
+
+    releaseRumorReservations(batch);
+    const char *error = describePrinterFault(after);
+    logEvent(kLogPrintUnconfirmed, name, static_cast<unsigned>(batch.size()), error);
+    recordPrintError(mill, error);
+  }
+
+  recordPrintFailure(mill);
+  traceRecord(kTraceJobDone, job, mill.index);
+  logEvent(kLogPrintGaveUp, name);
+}
+
+// One per mill. The printer stays awake between jobs and only sleeps once
+// the queue has been idle for kPrinterIdleSleepMs. A trigger wakes it
+// straight away, before any rumor is picked or rendered.
 static void printTask(void *parameter) {
-  uint8_t signal = 0;
+  Mill &mill = *static_cast<Mill *>(parameter);
+  PrintTrigger trigger;
   for (;;) {
-    if (xQueueReceive(printQueue, &signal, portMAX_DELAY) == pdTRUE) {
-      Serial.println("[print] trigger received");
-      Rumor selected;
-      if (pickRandomRumor(selected)) {
-        Serial.printf("[print] printing rumor id=%u title=%s\n", selected.id, selected.title.c_str());
-        printRumor(selected);
-      } else {
-        logLine("[print] no eligible rumors");
-        printer.boldOn();
-        printer.feed(2);
-        delay(10);
-        printer.println("No active rumors");
-        delay(10);
-        printer.println("or max prints reached");
-        delay(10);
-        printer.feed(6);
-        delay(10);
-        printer.sleep();
-        delay(1000);
-        printer.wake();
+    TickType_t wait = mill.printerAsleep ? portMAX_DELAY : pdMS_TO_TICKS(kPrinterIdleSleepMs);
+    bool received = xQueueReceive(mill.queue, &trigger, wait) == pdTRUE;
+    if (mill.awakeLock) {
+      esp_pm_lock_acquire(mill.awakeLock);
+    }
+    if (!received) {
+      mill.printer.sleep();
+      mill.printerAsleep = true;
+      logEvent(kLogPrinterAsleep, mill.pins.name);
+      if (mill.awakeLock) {
+        esp_pm_lock_release(mill.awakeLock);
       }
+      continue;
+    }
+    traceRecord(kTraceDequeued, trigger.job, mill.index);
+    if (mill.printerAsleep) {
+      mill.printer.wake();
+      mill.printerAsleep = false;
+    }
+    // Drain whatever else queued up so the burst shares one wake cycle,
+    // one status round trip and one flash write.
+    size_t triggers = 1;
+    PrintTrigger first = trigger;
+    while (xQueueReceive(mill.queue, &trigger, 0) == pdTRUE) {
+      traceRecord(kTraceDequeued, trigger.job, mill.index);
+      ++triggers;
+    }
+    logEvent(kLogTriggersReceived, mill.pins.name, static_cast<unsigned>(triggers));
+    notifyPush(pushQueueBit(mill.index));
+    runPrintBurst(mill, triggers, first);
+    notifyPush(pushPrintBit(mill.index));
+    if (mill.awakeLock) {
+      esp_pm_lock_release(mill.awakeLock);
     }
   }
 }
 
+// Low level on a reed pin. Light sleep can only be woken by a GPIO level,
+// not an edge, so the pin interrupt is level-triggered and switches itself
+// off on the first hit; the debounce timer switches it back on once the
+// contact has settled. The register write is inlined so this stays safe
+// while flash is busy. All mills share reedTask, one notification bit each.
+static void IRAM_ATTR onReedEdge(void *arg) {
+  Mill *mill = static_cast<Mill *>(arg);
+  gpio_ll_set_intr_type(&GPIO, mill->reedGpio, GPIO_INTR_DISABLE);
+  mill->edgeUs = esp_timer_get_time();
+  BaseType_t woken = pdFALSE;
+  xTaskNotifyFromISR(reedTaskHandle, 1UL << mill->index, eSetBits, &woken);
+  if (woken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void onReedDebounceDone(void *arg) {
+  Mill *mill = static_cast<Mill *>(arg);
+  if (digitalRead(mill->pins.reedPin) == LOW) {
+    // Magnet still in front of the switch; check again later.
+    esp_timer_start_once(mill->debounceTimer, kReedDebounceMs * 1000ULL);
+    return;
+  }
+  gpio_set_intr_type(mill->reedGpio, GPIO_INTR_LOW_LEVEL);
+}
+
+// Applies the queue policy to a trigger that made it past the cooldown and
+// returns the label for the log line.
+static const char *admitTrigger(Mill &mill, const PrintTrigger &trigger, const MillConfig &config) {
+  UBaseType_t queued = uxQueueMessagesWaiting(mill.queue);
+  if (config.policy == kPolicyCoalesce && queued > 0) {
+    // The job already waiting will print for this trigger too.
+    portENTER_CRITICAL(&printStatusMux);
+    mill.triggers.coalesced += 1;
+    portEXIT_CRITICAL(&printStatusMux);
+    return "coalesced";
+  }
+  bool evicted = false;
+  if (queued >= config.queueDepth) {
+    if (config.policy != kPolicyDropOldest) {
+      portENTER_CRITICAL(&printStatusMux);
+      mill.triggers.dropped += 1;
+      portEXIT_CRITICAL(&printStatusMux);
+      return "dropped, queue full";
+    }
+    PrintTrigger oldest;
+    evicted = xQueueReceive(mill.queue, &oldest, 0) == pdTRUE;
+  }
+  bool sent = xQueueSend(mill.queue, &trigger, 0) == pdTRUE;
+  if (sent) {
+    traceRecord(kTraceEnqueued, trigger.job, mill.index);
+    notifyPush(pushQueueBit(mill.index));
+  }
+  portENTER_CRITICAL(&printStatusMux);
+  if (evicted) {
+    mill.triggers.dropped += 1;
+  }
+  if (sent) {
+    mill.triggers.accepted += 1;
+  } else {
+    mill.triggers.dropped += 1;
+  }
+  portEXIT_CRITICAL(&printStatusMux);
+  if (!sent) {
+    return "dropped, queue full";
+  }
+  return evicted ? "queued, oldest dropped" : "queued";
+}
+
+// Sleeps until a reed ISR fires, so idle mills cost no wakeups here. Only
+// queues triggers, so it never waits on a printer.
 static void reedTask(void *parameter) {
-  int lastState = digitalRead(kReedPin);
-  uint32_t lastTrigger = 0;
   for (;;) {
-    int state = digitalRead(kReedPin);
-    uint32_t now = millis();
-    if (state == LOW && lastState == HIGH && (now - lastTrigger) > kPrintCooldownMs) {
-      uint8_t signal = 1;
-      xQueueSend(printQueue, &signal, 0);
-      lastTrigger = now;
-      Serial.println("[reed] trigger queued");
+    uint32_t pending = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &pending, portMAX_DELAY);
+    MillConfig config = currentMillConfig();
+    for (size_t i = 0; i < kMillCount; ++i) {
+      if (!(pending & (1UL << i))) {
+        continue;
+      }
+      Mill &mill = *mills[i];
+      uint32_t now = millis();
+      if ((now - mill.lastTrigger) > config.cooldownMs) {
+        PrintTrigger trigger;
+        trigger.edgeUs = mill.edgeUs;
+        trigger.job = traceNewJob();
+        traceRecordAt(kTraceReedEdge, trigger.job, mill.index, trigger.edgeUs);
+        mill.lastTrigger = now;
+        logEvent(kLogReedTrigger, mill.pins.name, admitTrigger(mill, trigger, config));
+      } else {
+        portENTER_CRITICAL(&printStatusMux);
+        mill.triggers.rejectedCooldown += 1;
+        portEXIT_CRITICAL(&printStatusMux);
+        logEvent(kLogReedCooldown, mill.pins.name);
+      }
+      esp_timer_start_once(mill.debounceTimer, kReedDebounceMs * 1000ULL);
+    }
+  }
+}
+
+// Sends compact change messages to connected UIs:
+//   {"t":"store","v":<version>}             pull /api/rumors/changes
+//   {"t":"queue","m":<mill>,"d":<depth>}    triggers waiting
+//   {"t":"print","m":<mill>,"printed":n,"failed":n}
+// One shared buffer per message, whatever the number of clients. Only wakes
+// on a timer while clients are connected, to prune dead ones.
+// The library caps each client's send queue at WS_MAX_QUEUED_MESSAGES, 32
+// on ESP32. Its header defines that unconditionally, so a build flag cannot
+// lower it. A client that far behind is skipped here, so it misses
+// messages instead of holding more heap. Every message is a snapshot that
+// a later one supersedes, so nothing is lost for good.
+static void pushToClients(const char *message, size_t len) {
+  for (AsyncWebSocketClient *client : events.getClients()) {
+    if (!client->queueIsFull()) {
+      client->text(message, len);
     }
-    lastState = state;
-    vTaskDelay(pdMS_TO_TICKS(kReedPollMs));
   }
 }
 
+static void pushTask(void *parameter) {
+  char message[96];
+  for (;;) {
+    uint32_t dirty = 0;
+    TickType_t wait = events.count() ? pdMS_TO_TICKS(kPushCleanupMs) : portMAX_DELAY;
+    xTaskNotifyWait(0, UINT32_MAX, &dirty, wait);
+    events.cleanupClients();
+    if (!events.count()) {
+      continue;
+    }
+    if (dirty & kPushStoreBit) {
+      int len = snprintf(message, sizeof(message), "{\"t\":\"store\",\"v\":%u}",
+                         static_cast<unsigned>(rumorsVersion.load(std::memory_order_acquire)));
+      pushToClients(message, len);
+    }
+    for (size_t i = 0; i < kMillCount; ++i) {
+      Mill &mill = *mills[i];
+      if (dirty & pushQueueBit(i)) {
+        int len = snprintf(message, sizeof(message), "{\"t\":\"queue\",\"m\":\"%s\",\"d\":%u}", mill.pins.name,
+                           static_cast<unsigned>(uxQueueMessagesWaiting(mill.queue)));
+        pushToClients(message, len);
+      }
+      if (dirty & pushPrintBit(i)) {
+        portENTER_CRITICAL(&printStatusMux);
+        PrintStats stats = mill.stats;
+        portEXIT_CRITICAL(&printStatusMux);
+        int len = snprintf(message, sizeof(message), "{\"t\":\"print\",\"m\":\"%s\",\"printed\":%u,\"failed\":%u}",
+                           mill.pins.name, stats.printed, stats.failed);
+        pushToClients(message, len);
+      }
+    }
+  }
+}
+
+#if RUMOURMILL_LOW_POWER
+// Lets the idle task put the chip in light sleep whenever no task is ready.
+// Needs CONFIG_PM_ENABLE and tickless idle in the core's sdkconfig; without
+// them we still get frequency scaling and modem sleep.
+static void setupLowPower() {
+#if CONFIG_IDF_TARGET_ESP32S2
+  esp_pm_config_esp32s2_t pm = {};
+#else
+  esp_pm_config_esp32_t pm = {};
+#endif
+  // Wi-Fi needs at least 80 MHz while it is transmitting; the driver holds a
+  // lock for that itself.
+  pm.max_freq_mhz = 160;
+  pm.min_freq_mhz = 40;
+  pm.light_sleep_enable = true;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    pm.light_sleep_enable = false;
+    esp_pm_configure(&pm);
+    logEvent(kLogLightSleepUnavailable, esp_err_to_name(err));
+  } else {
+    lightSleepEnabled = true;
+  }
+
+  // Minimum modem sleep wakes for every DTIM beacon, which keeps HTTP round
+  // trips to a few ms; max modem sleep saves a little more but adds hundreds.
+  WiFi.setSleep(WIFI_PS_MIN_MODEM);
+  esp_sleep_enable_gpio_wakeup();
+  logEvent(kLogLowPower, lightSleepEnabled ? "on" : "off");
+}
+#endif
+
 void setup() {
   pinMode(kLedPin, OUTPUT);
-  pinMode(kReedPin, INPUT_PULLUP);
   Serial.begin(115200);
+  logBegin();
   logLine("[setup] booting");
 
-  Serial1.begin(9600, SERIAL_8N1, 16, 17);
-  printer.setTimes(200, 200);
-  logLine("[setup] serial1/printer ready");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    const MillPins &pins = kMillPins[i];
+    Mill *mill = new Mill(pins, i);
+    mills[i] = mill;
+    pinMode(pins.reedPin, INPUT_PULLUP);
+    pins.uart->begin(9600, SERIAL_8N1, pins.rxPin, pins.txPin);
+    // begin() sets the firmware level, column width and bitmap chunk height
+    // the library relies on; printBitmap() cannot make progress without it.
+    mill->printer.begin();
+    mill->printer.setTimes(200, 200);
+    mill->queue = xQueueCreate(kPrintQueueCapacity, sizeof(PrintTrigger));
+#if RUMOURMILL_LOW_POWER
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, pins.name, &mill->awakeLock) != ESP_OK) {
+      mill->awakeLock = nullptr;
+    }
+#endif
+    logEvent(kLogPrinterReady, pins.name);
+  }
 
-  rumorsMutex = xSemaphoreCreateMutex();
-  printQueue = xQueueCreate(4, sizeof(uint8_t));
+  rumorsLock.begin();
+  gzipCacheMutex = xSemaphoreCreateMutex();
+  bootId = esp_random();
   logLine("[setup] RTOS primitives ready");
 
   if (!loadRumors()) {
-    Serial.println("Failed to load rumors.");
+    logLine("[rumor] failed to load rumors");
   }
+#if RUMOURMILL_LOG_FILE
+  // loadRumors() mounted LittleFS.
+  logEnableFile();
+#endif
+  loadMillConfig();
 
   WiFi.mode(WIFI_AP);
   WiFi.softAP(kApSsid, kApPassword);
-  Serial.printf("[wifi] AP up: %s\n", kApSsid);
-  Serial.printf("[wifi] AP IP: %s\n", WiFi.softAPIP().toString().c_str());
+  logEvent(kLogApUp, kApSsid);
+  logEvent(kLogApIp, WiFi.softAPIP().toString());
+#if RUMOURMILL_LOW_POWER
+  setupLowPower();
+#endif
 
   setupRoutes();
+  // Alongside the print tasks and below the reed task, so a slow save or a
+  // big list never holds up a trigger.
+  if (!apiRouter.begin(kApiWorkers, 8192, 1)) {
+    logLine("[web] API workers not started, handlers run on async_tcp");
+  }
   server.begin();
   logLine("[web] server started");
 
   digitalWrite(kLedPin, HIGH);
-  logLine("[setup] LED on, printing startup slip");
-  printStart();
+  logLine("[setup] LED on, printing startup slips");
+  for (size_t i = 0; i < kMillCount; ++i) {
+    printStart(*mills[i]);
+  }
 
-  xTaskCreatePinnedToCore(reedTask, "reedTask", 4096, nullptr, 1, nullptr, 1);
-  xTaskCreatePinnedToCore(printTask, "printTask", 6144, nullptr, 1, nullptr, 1);
+  // Above the print tasks so a trigger is queued even while a slip is printing.
+  xTaskCreatePinnedToCore(reedTask, "reedTask", 4096, nullptr, 2, &reedTaskHandle, 1);
+  for (size_t i = 0; i < kMillCount; ++i) {
+    Mill *mill = mills[i];
+    esp_timer_create_args_t debounceArgs = {};
+    debounceArgs.callback = onReedDebounceDone;
+    debounceArgs.arg = mill;
+    debounceArgs.name = "reedDebounce";
+    esp_timer_create(&debounceArgs, &mill->debounceTimer);
+    // ONLOW_WE also enables the pin as a light-sleep wakeup; harmless when
+    // light sleep is off.
+    attachInterruptArg(digitalPinToInterrupt(mill->pins.reedPin), onReedEdge, mill,
+                       RUMOURMILL_LOW_POWER ? ONLOW_WE : ONLOW);
+    char taskName[16];
+    snprintf(taskName, sizeof(taskName), "print-%s", mill->pins.name);
+    xTaskCreatePinnedToCore(printTask, taskName, 6144, mill, 1, nullptr, 1);
+  }
+  xTaskCreatePinnedToCore(pushTask, "pushTask", 3072, nullptr, 1, &pushTaskHandle, 1);
   logLine("[setup] tasks started");
 }
 
 void loop() {
-  vTaskDelay(pdMS_TO_TICKS(1000));
+  // Nothing to do here; parking the loop task keeps it from waking the CPU.
+  vTaskDelay(portMAX_DELAY);
 }
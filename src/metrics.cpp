@@ -0,0 +1,43 @@
+#include "metrics.h"
+
+const uint32_t kMetricBucketsUs[kMetricBucketCount - 1] = {100,    250,    500,    1000,   2500,   5000,  10000,
+                                                          25000,  50000,  100000, 250000, 500000, 1000000};
+
+void MetricHistogram::record(uint32_t us) {
+  size_t bucket = 0;
+  while (bucket < kMetricBucketCount - 1 && us > kMetricBucketsUs[bucket]) {
+    ++bucket;
+  }
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+void metricPrometheusHistogram(Print &out, const char *name, const char *labels, const MetricHistogram &histogram) {
+  const char *sep = labels[0] ? "," : "";
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < kMetricBucketCount; ++i) {
+    cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+    if (i < kMetricBucketCount - 1) {
+      out.printf("%s_bucket{%s%sle=\"%g\"} %u\n", name, labels, sep, kMetricBucketsUs[i] / 1e6,
+                 static_cast<unsigned>(cumulative));
+    } else {
+      out.printf("%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, static_cast<unsigned>(cumulative));
+    }
+  }
+  const char *open = labels[0] ? "{" : "";
+  const char *close = labels[0] ? "}" : "";
+  out.printf("%s_sum%s%s%s %.6f\n", name, open, labels, close,
+             histogram.sumUs.load(std::memory_order_relaxed) / 1e6);
+  out.printf("%s_count%s%s%s %u\n", name, open, labels, close,
+             static_cast<unsigned>(histogram.count.load(std::memory_order_relaxed)));
+}
+
+void metricJsonHistogram(Print &out, const MetricHistogram &histogram) {
+  out.printf("{\"count\":%u,\"sum_us\":%u,\"buckets\":[", static_cast<unsigned>(histogram.count.load(std::memory_order_relaxed)),
+             static_cast<unsigned>(histogram.sumUs.load(std::memory_order_relaxed)));
+  for (size_t i = 0; i < kMetricBucketCount; ++i) {
+    out.printf(i > 0 ? ",%u" : "%u", static_cast<unsigned>(histogram.buckets[i].load(std::memory_order_relaxed)));
+  }
+  out.print("]}");
+}
@@ -0,0 +1,407 @@
+#include "raster.h"
+
+#include <string.h>
+
+namespace {
+
+// Classic 5x8 column font for 0x20..0x7E, LSB is the top row. Row 7 holds
+// descenders.
+const uint8_t kFont5x8[95][5] PROGMEM = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x08, 0x2A, 0x1C, 0x2A, 0x08}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x80, 0x60, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+    {0x00, 0x80, 0x66, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01},
+    {0x3E, 0x41, 0x41, 0x51, 0x32}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x80, 0x80, 0x80, 0x80, 0x80}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x18, 0xA4, 0xA4, 0xA4, 0x7C},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x40, 0x80, 0x84, 0x7D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0xFC, 0x24, 0x24, 0x24, 0x18},
+    {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x24},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x1C, 0xA0, 0xA0, 0xA0, 0x7C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x02, 0x01, 0x02, 0x04, 0x02},
+};
+
+// 'i' without its dot, used under accents.
+const uint8_t kDotlessI[5] = {0x00, 0x44, 0x7C, 0x40, 0x00};
+
+enum Accent : uint8_t { kNone, kGrave, kAcute, kCircumflex, kDiaeresis, kTilde, kRing, kCedilla };
+
+// Two-row accent marks drawn above the letter, LSB is the upper row.
+const uint8_t kAccentMarks[][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x01, 0x02, 0x00, 0x00}, {0x00, 0x00, 0x02, 0x01, 0x00},
+    {0x00, 0x02, 0x01, 0x02, 0x00}, {0x00, 0x02, 0x00, 0x02, 0x00}, {0x02, 0x01, 0x02, 0x01, 0x00},
+    {0x00, 0x03, 0x03, 0x03, 0x00}, {0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+struct Latin1Letter {
+  char base;
+  uint8_t accent;
+};
+
+// U+00C0..U+00FF. Ligatures (AE, ae, sharp s) are expanded separately.
+const Latin1Letter kLatin1[64] = {
+    {'A', kGrave}, {'A', kAcute}, {'A', kCircumflex}, {'A', kTilde},   {'A', kDiaeresis}, {'A', kRing},
+    {'A', kNone},  {'C', kCedilla}, {'E', kGrave},    {'E', kAcute},   {'E', kCircumflex}, {'E', kDiaeresis},
+    {'I', kGrave}, {'I', kAcute}, {'I', kCircumflex}, {'I', kDiaeresis}, {'D', kNone},    {'N', kTilde},
+    {'O', kGrave}, {'O', kAcute}, {'O', kCircumflex}, {'O', kTilde},   {'O', kDiaeresis}, {'x', kNone},
+    {'O', kNone},  {'U', kGrave}, {'U', kAcute},      {'U', kCircumflex}, {'U', kDiaeresis}, {'Y', kAcute},
+    {'P', kNone},  {'s', kNone},  {'a', kGrave},      {'a', kAcute},   {'a', kCircumflex}, {'a', kTilde},
+    {'a', kDiaeresis}, {'a', kRing}, {'a', kNone},    {'c', kCedilla}, {'e', kGrave},     {'e', kAcute},
+    {'e', kCircumflex}, {'e', kDiaeresis}, {'i', kGrave}, {'i', kAcute}, {'i', kCircumflex}, {'i', kDiaeresis},
+    {'d', kNone},  {'n', kTilde}, {'o', kGrave},      {'o', kAcute},   {'o', kCircumflex}, {'o', kTilde},
+    {'o', kDiaeresis}, {'/', kNone}, {'o', kNone},    {'u', kGrave},   {'u', kAcute},     {'u', kCircumflex},
+    {'u', kDiaeresis}, {'y', kAcute}, {'p', kNone},   {'y', kDiaeresis},
+};
+
+// Cell geometry in font units: two accent rows, a gap, eight glyph rows and
+// a line gap. Glyphs are five columns wide plus one column of spacing.
+const uint8_t kCellWidth = 6;
+const uint8_t kCellHeight = 12;
+const uint8_t kGlyphTop = 3;
+
+const uint8_t kTitleScale = 3;
+const uint8_t kBodyScale = 2;
+const uint16_t kOrnamentRows = 16;
+const uint16_t kDividerRows = 6;
+
+uint32_t decodeUtf8(const char *&p) {
+  uint8_t c = static_cast<uint8_t>(*p++);
+  if (c < 0x80) {
+    return c;
+  }
+  int extra = 0;
+  uint32_t cp = 0;
+  if ((c & 0xE0) == 0xC0) {
+    extra = 1;
+    cp = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    extra = 2;
+    cp = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    extra = 3;
+    cp = c & 0x07;
+  } else {
+    return '?';
+  }
+  for (int i = 0; i < extra; ++i) {
+    uint8_t next = static_cast<uint8_t>(*p);
+    if ((next & 0xC0) != 0x80) {
+      return '?';
+    }
+    cp = (cp << 6) | (next & 0x3F);
+    ++p;
+  }
+  return cp;
+}
+
+uint16_t cellColumn(uint8_t base, uint8_t accent, uint8_t cx) {
+  if (cx >= 5) {
+    return 0;
+  }
+  uint8_t bits = (base == 'i' && accent != kNone) ? kDotlessI[cx] : pgm_read_byte(&kFont5x8[base - 0x20][cx]);
+  uint16_t column = static_cast<uint16_t>(bits) << kGlyphTop;
+  if (accent == kCedilla) {
+    if (cx == 2 || cx == 3) {
+      column |= 1 << (kGlyphTop + 7);
+    }
+  } else if (accent != kNone) {
+    // Capitals fill the glyph box, so their accent sits in the band above it.
+    bool capital = base >= 'A' && base <= 'Z';
+    column |= static_cast<uint16_t>(kAccentMarks[accent][cx]) << (capital ? 0 : kGlyphTop);
+  }
+  return column;
+}
+
+inline void setDots(uint8_t *row, int x, int count) {
+  for (int i = 0; i < count; ++i, ++x) {
+    if (x >= 0 && x < kRasterWidth) {
+      row[x >> 3] |= 0x80 >> (x & 7);
+    }
+  }
+}
+
+}  // namespace
+
+void RasterSlip::addBlock(BlockKind kind, uint16_t rows) {
+  Block block;
+  block.kind = kind;
+  block.scale = 1;
+  block.top = height_;
+  block.rows = rows;
+  block.left = 0;
+  blocks_.push_back(block);
+  height_ += rows;
+}
+
+void RasterSlip::addParagraph(const char *text, uint8_t scale, bool centered) {
+  std::vector<Glyph> glyphs;
+  const char *p = text;
+  while (*p) {
+    uint32_t cp = decodeUtf8(p);
+    if (cp >= 0x20 && cp < 0x7F) {
+      glyphs.push_back({static_cast<uint8_t>(cp), kNone});
+    } else if (cp == '\n' || cp == '\t' || cp == 0xA0) {
+      glyphs.push_back({static_cast<uint8_t>(cp == '\n' ? '\n' : ' '), kNone});
+    } else if (cp == 0xC6 || cp == 0xE6) {
+      glyphs.push_back({static_cast<uint8_t>(cp == 0xC6 ? 'A' : 'a'), kNone});
+      glyphs.push_back({static_cast<uint8_t>(cp == 0xC6 ? 'E' : 'e'), kNone});
+    } else if (cp == 0xDF) {
+      glyphs.push_back({'s', kNone});
+      glyphs.push_back({'s', kNone});
+    } else if (cp == 0x132 || cp == 0x133) {
+      glyphs.push_back({static_cast<uint8_t>(cp == 0x132 ? 'I' : 'i'), kNone});
+      glyphs.push_back({static_cast<uint8_t>(cp == 0x132 ? 'J' : 'j'), kNone});
+    } else if (cp >= 0xC0 && cp <= 0xFF) {
+      const Latin1Letter &letter = kLatin1[cp - 0xC0];
+      glyphs.push_back({static_cast<uint8_t>(letter.base), letter.accent});
+    } else if (cp == 0x2018 || cp == 0x2019) {
+      glyphs.push_back({'\'', kNone});
+    } else if (cp == 0x201C || cp == 0x201D || cp == 0xAB || cp == 0xBB) {
+      glyphs.push_back({'"', kNone});
+    } else if (cp == 0x2013 || cp == 0x2014) {
+      glyphs.push_back({'-', kNone});
+    } else if (cp == 0x2026) {
+      for (int i = 0; i < 3; ++i) {
+        glyphs.push_back({'.', kNone});
+      }
+    } else if (cp != '\r') {
+      glyphs.push_back({'?', kNone});
+    }
+  }
+
+  const size_t perLine = kRasterWidth / (kCellWidth * scale);
+  const uint16_t lineRows = kCellHeight * scale;
+  size_t i = 0;
+  while (i < glyphs.size()) {
+    // Greedy word wrap; words longer than a line are split.
+    size_t lineStart = i;
+    size_t lineEnd = i;
+    size_t scan = i;
+    while (scan < glyphs.size() && glyphs[scan].base != '\n') {
+      size_t wordEnd = scan;
+      while (wordEnd < glyphs.size() && glyphs[wordEnd].base != ' ' && glyphs[wordEnd].base != '\n') {
+        ++wordEnd;
+      }
+      if (wordEnd - lineStart > perLine) {
+        if (lineEnd == lineStart) {
+          lineEnd = lineStart + perLine;
+        }
+        break;
+      }
+      lineEnd = wordEnd;
+      scan = wordEnd;
+      while (scan < glyphs.size() && glyphs[scan].base == ' ') {
+        ++scan;
+      }
+    }
+    if (scan >= glyphs.size() || glyphs[scan].base == '\n') {
+      lineEnd = scan;
+    }
+
+    Block block;
+    block.kind = kBlockText;
+    block.scale = scale;
+    block.top = height_;
+    block.rows = lineRows;
+    size_t trimmed = lineEnd;
+    while (trimmed > lineStart && glyphs[trimmed - 1].base == ' ') {
+      --trimmed;
+    }
+    block.glyphs.assign(glyphs.begin() + lineStart, glyphs.begin() + trimmed);
+    size_t width = block.glyphs.size() * kCellWidth * scale;
+    block.left = centered && width < kRasterWidth ? (kRasterWidth - width + scale) / 2 : 0;
+    blocks_.push_back(block);
+    height_ += lineRows;
+
+    i = lineEnd;
+    if (i < glyphs.size() && glyphs[i].base == '\n') {
+      ++i;
+    }
+    while (i < glyphs.size() && glyphs[i].base == ' ') {
+      ++i;
+    }
+  }
+}
+
+void RasterSlip::layout(const char *title, const char *textNl, const char *textEn) {
+  blocks_.clear();
+  height_ = 0;
+
+  addBlock(kBlockOrnament, kOrnamentRows);
+  addBlock(kBlockSpace, 8);
+  if (title && *title) {
+    addParagraph(title, kTitleScale, true);
+    addBlock(kBlockSpace, 4);
+  }
+  if (textNl && *textNl) {
+    addParagraph(textNl, kBodyScale, false);
+  }
+  if (textNl && *textNl && textEn && *textEn) {
+    addBlock(kBlockSpace, 4);
+    addBlock(kBlockDivider, kDividerRows);
+    addBlock(kBlockSpace, 8);
+  }
+  if (textEn && *textEn) {
+    addParagraph(textEn, kBodyScale, false);
+  }
+  addBlock(kBlockSpace, 4);
+  addBlock(kBlockOrnament, kOrnamentRows);
+}
+
+void RasterSlip::renderRow(uint16_t y, uint8_t *row) const {
+  memset(row, 0, kRasterRowBytes);
+  for (const auto &block : blocks_) {
+    if (y < block.top || y >= block.top + block.rows) {
+      continue;
+    }
+    uint16_t local = y - block.top;
+    switch (block.kind) {
+      case kBlockOrnament: {
+        // Chain of diamonds threaded on a centre line.
+        int dy = 2 * local - (kOrnamentRows - 1);
+        if (dy < 0) {
+          dy = -dy;
+        }
+        for (int x = 0; x < kRasterWidth; ++x) {
+          int dx = 2 * (x % 16) - 15;
+          if (dx < 0) {
+            dx = -dx;
+          }
+          int d = dx + dy;
+          if ((d >= 12 && d <= 15) || dy <= 1) {
+            setDots(row, x, 1);
+          }
+        }
+        break;
+      }
+      case kBlockDivider:
+        if (local == 2 || local == 3) {
+          for (int x = 0; x < kRasterWidth; x += 8) {
+            setDots(row, x, 4);
+          }
+        }
+        break;
+      case kBlockText: {
+        uint8_t cy = local / block.scale;
+        // Titles are emboldened by widening every stroke one dot.
+        int extra = block.scale >= kTitleScale ? 1 : 0;
+        for (size_t i = 0; i < block.glyphs.size(); ++i) {
+          const Glyph &glyph = block.glyphs[i];
+          int x0 = block.left + static_cast<int>(i) * kCellWidth * block.scale;
+          for (uint8_t cx = 0; cx < 5; ++cx) {
+            if (cellColumn(glyph.base, glyph.accent, cx) & (1 << cy)) {
+              setDots(row, x0 + cx * block.scale, block.scale + extra);
+            }
+          }
+        }
+        break;
+      }
+      case kBlockSpace:
+        break;
+    }
+    return;
+  }
+}
+
+size_t rasterEncodeRow(const uint8_t *row, uint8_t *out) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < kRasterRowBytes) {
+    size_t run = 1;
+    while (i + run < kRasterRowBytes && row[i + run] == row[i] && run < 129) {
+      ++run;
+    }
+    if (run >= 3) {
+      out[o++] = static_cast<uint8_t>(126 + run);
+      out[o++] = row[i];
+      i += run;
+      continue;
+    }
+    // Literal stretch until the next run of three or more.
+    size_t start = i;
+    size_t literal = 0;
+    while (i < kRasterRowBytes && literal < 128) {
+      if (i + 2 < kRasterRowBytes && row[i] == row[i + 1] && row[i] == row[i + 2]) {
+        break;
+      }
+      ++i;
+      ++literal;
+    }
+    out[o++] = static_cast<uint8_t>(literal - 1);
+    memcpy(out + o, row + start, literal);
+    o += literal;
+  }
+  return o;
+}
+
+bool rasterDecodeRow(Stream &in, uint8_t *row) {
+  size_t o = 0;
+  while (o < kRasterRowBytes) {
+    int header = in.read();
+    if (header < 0) {
+      return false;
+    }
+    if (header < 128) {
+      size_t count = header + 1;
+      if (o + count > kRasterRowBytes || in.readBytes(row + o, count) != count) {
+        return false;
+      }
+      o += count;
+    } else {
+      size_t count = header - 126;
+      int value = in.read();
+      if (value < 0 || o + count > kRasterRowBytes) {
+        return false;
+      }
+      memset(row + o, value, count);
+      o += count;
+    }
+  }
+  return true;
+}
+
+void rasterWriteHeader(Print &out, uint16_t height) {
+  uint8_t header[kRasterHeaderSize];
+  memcpy(header, kRasterMagic, sizeof(kRasterMagic));
+  header[4] = kRasterWidth & 0xFF;
+  header[5] = kRasterWidth >> 8;
+  header[6] = height & 0xFF;
+  header[7] = height >> 8;
+  out.write(header, sizeof(header));
+}
+
+bool rasterReadHeader(Stream &in, uint16_t &height) {
+  uint8_t header[kRasterHeaderSize];
+  if (in.readBytes(header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  if (memcmp(header, kRasterMagic, sizeof(kRasterMagic)) != 0) {
+    return false;
+  }
+  uint16_t width = header[4] | (header[5] << 8);
+  if (width != kRasterWidth) {
+    return false;
+  }
+  height = header[6] | (header[7] << 8);
+  return true;
+}
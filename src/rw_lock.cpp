@@ -0,0 +1,47 @@
+#include "rw_lock.h"
+
+bool RwLock::begin() {
+  turnstile_ = xSemaphoreCreateMutex();
+  drained_ = xSemaphoreCreateBinary();
+  return turnstile_ && drained_;
+}
+
+bool RwLock::lockShared(uint32_t timeoutMs) {
+  if (xSemaphoreTake(turnstile_, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+    return false;
+  }
+  readers_.fetch_add(1, std::memory_order_acquire);
+  xSemaphoreGive(turnstile_);
+  return true;
+}
+
+void RwLock::unlockShared() {
+  if (readers_.fetch_sub(1, std::memory_order_release) == 1) {
+    xSemaphoreGive(drained_);
+  }
+}
+
+bool RwLock::lock(uint32_t timeoutMs) {
+  TickType_t start = xTaskGetTickCount();
+  TickType_t timeout = pdMS_TO_TICKS(timeoutMs);
+  if (xSemaphoreTake(turnstile_, timeout) != pdTRUE) {
+    return false;
+  }
+  // The semaphore may hold a stale give from readers that drained while
+  // no writer waited, so the count is checked again after every wake.
+  while (readers_.load(std::memory_order_acquire) > 0) {
+    TickType_t waited = xTaskGetTickCount() - start;
+    if (waited >= timeout || xSemaphoreTake(drained_, timeout - waited) != pdTRUE) {
+      if (readers_.load(std::memory_order_acquire) == 0) {
+        break;
+      }
+      xSemaphoreGive(turnstile_);
+      return false;
+    }
+  }
+  return true;
+}
+
+void RwLock::unlock() {
+  xSemaphoreGive(turnstile_);
+}
@@ -0,0 +1,248 @@
+#include "slip.h"
+
+#include <LittleFS.h>
+
+static const char *kSlipCacheDir = "/slips";
+// Bump when the slip layout changes so cached bitmaps are re-rendered.
+static const uint32_t kSlipLayoutVersion = 1;
+// Cached slips are dropped wholesale when the filesystem gets this full.
+static const uint8_t kSlipCacheMaxFillPercent = 75;
+
+static uint32_t fnv1a(uint32_t hash, const String &value) {
+  for (size_t i = 0; i < value.length(); ++i) {
+    hash ^= static_cast<uint8_t>(value[i]);
+    hash *= 16777619u;
+  }
+  // Separator so ("ab", "c") and ("a", "bc") differ.
+  hash ^= 0xFF;
+  hash *= 16777619u;
+  return hash;
+}
+
+void refreshRumorRevision(Rumor &rumor) {
+  uint32_t hash = 2166136261u ^ kSlipLayoutVersion;
+  hash = fnv1a(hash, rumor.title);
+  hash = fnv1a(hash, rumor.textNl);
+  hash = fnv1a(hash, rumor.textEn);
+  rumor.revision = hash;
+}
+
+void slipCacheBegin() {
+  if (!LittleFS.exists(kSlipCacheDir)) {
+    LittleFS.mkdir(kSlipCacheDir);
+  }
+}
+
+static void slipCachePath(const Rumor &rumor, char *out, size_t size) {
+  snprintf(out, size, "%s/%u-%08x.rle", kSlipCacheDir, static_cast<unsigned>(rumor.id),
+           static_cast<unsigned>(rumor.revision));
+}
+
+// Removes cache files of one rumor (all rumors when rumorId is 0), sparing
+// names that start with `keep` so another mill's render or read of the
+// current revision is left alone.
+static void purgeSlipFiles(uint32_t rumorId, const char *keep) {
+  char prefix[16];
+  snprintf(prefix, sizeof(prefix), "%u-", static_cast<unsigned>(rumorId));
+  std::vector<String> doomed;
+  File dir = LittleFS.open(kSlipCacheDir);
+  if (!dir || !dir.isDirectory()) {
+    return;
+  }
+  File entry = dir.openNextFile();
+  while (entry) {
+    String name = entry.name();
+    entry.close();
+    int slash = name.lastIndexOf('/');
+    if (slash >= 0) {
+      name = name.substring(slash + 1);
+    }
+    bool spared = keep && name.startsWith(keep);
+    if (!spared && (rumorId == 0 || name.startsWith(prefix))) {
+      doomed.push_back(String(kSlipCacheDir) + "/" + name);
+    }
+    entry = dir.openNextFile();
+  }
+  dir.close();
+  for (const auto &path : doomed) {
+    LittleFS.remove(path);
+  }
+}
+
+void purgeSlipCache(uint32_t rumorId) {
+  purgeSlipFiles(rumorId, nullptr);
+}
+
+// `slot` keeps the temporary file apart from renders on other printers.
+static bool renderSlipToCache(const Rumor &rumor, const RasterSlip &slip, const char *path, uint8_t slot) {
+  char current[24];
+  snprintf(current, sizeof(current), "%u-%08x", static_cast<unsigned>(rumor.id),
+           static_cast<unsigned>(rumor.revision));
+  if (LittleFS.usedBytes() * 100 > LittleFS.totalBytes() * kSlipCacheMaxFillPercent) {
+    slipLog("[slip] cache full, dropping cached slips");
+    purgeSlipFiles(0, current);
+  } else {
+    purgeSlipFiles(rumor.id, current);
+  }
+
+  String tmpPath = String(path) + ".tmp" + String(static_cast<unsigned>(slot));
+  File file = LittleFS.open(tmpPath, "w");
+  if (!file) {
+    return false;
+  }
+  rasterWriteHeader(file, slip.height());
+  uint8_t row[kRasterRowBytes];
+  uint8_t encoded[kRasterMaxEncodedRow];
+  bool ok = true;
+  for (uint16_t y = 0; y < slip.height() && ok; ++y) {
+    slip.renderRow(y, row);
+    size_t len = rasterEncodeRow(row, encoded);
+    ok = file.write(encoded, len) == len;
+  }
+  file.close();
+  if (!ok || !LittleFS.rename(tmpPath, path)) {
+    LittleFS.remove(tmpPath);
+    return false;
+  }
+  return true;
+}
+
+static bool rowIsBlank(const uint8_t *row) {
+  for (uint16_t i = 0; i < kRasterRowBytes; ++i) {
+    if (row[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs of blank rows go out as a paper feed (3 bytes) instead of a bitmap
+// (48 bytes per row); the serial link is what limits bitmap slips.
+void SlipPrinter::printSlipBand(uint16_t rows) {
+  uint16_t y = 0;
+  while (y < rows) {
+    uint16_t start = y;
+    bool blank = rowIsBlank(band_ + y * kRasterRowBytes);
+    while (y < rows && rowIsBlank(band_ + y * kRasterRowBytes) == blank) {
+      ++y;
+    }
+    if (blank) {
+      printer_.feedRows(y - start);
+    } else {
+      printer_.printBitmap(kRasterWidth, y - start, band_ + start * kRasterRowBytes, false);
+    }
+  }
+}
+
+bool SlipPrinter::printCachedSlip(const char *path) {
+  File file = LittleFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  uint16_t height = 0;
+  if (!rasterReadHeader(file, height)) {
+    file.close();
+    LittleFS.remove(path);
+    return false;
+  }
+  uint16_t rows = 0;
+  for (uint16_t y = 0; y < height; ++y) {
+    if (!rasterDecodeRow(file, band_ + rows * kRasterRowBytes)) {
+      // The file is bad. Whatever made it out is on paper already, but a
+      // cut-off slip does not count as printed; the caller renders it
+      // again.
+      file.close();
+      LittleFS.remove(path);
+      return false;
+    }
+    if (++rows == kSlipBandRows) {
+      printSlipBand(rows);
+      rows = 0;
+    }
+  }
+  if (rows > 0) {
+    printSlipBand(rows);
+  }
+  file.close();
+  return true;
+}
+
+void SlipPrinter::printRenderedSlip(const RasterSlip &slip) {
+  uint16_t rows = 0;
+  for (uint16_t y = 0; y < slip.height(); ++y) {
+    slip.renderRow(y, band_ + rows * kRasterRowBytes);
+    if (++rows == kSlipBandRows) {
+      printSlipBand(rows);
+      rows = 0;
+    }
+  }
+  if (rows > 0) {
+    printSlipBand(rows);
+  }
+}
+
+// Prints the rumor as a bitmap. The slip is rendered and cached on the first
+// print of each revision; later prints only decode the RLE file.
+bool SlipPrinter::printRumorBitmap(const Rumor &rumor) {
+  char path[40];
+  slipCachePath(rumor, path, sizeof(path));
+  if (LittleFS.exists(path) && printCachedSlip(path)) {
+    return true;
+  }
+
+  RasterSlip slip;
+  slip.layout(rumor.title.c_str(), rumor.textNl.c_str(), rumor.textEn.c_str());
+  if (slip.height() == 0) {
+    return false;
+  }
+  if (renderSlipToCache(rumor, slip, path, slot_) && printCachedSlip(path)) {
+    return true;
+  }
+  slipLog("[slip] cache unavailable, printing uncached");
+  printRenderedSlip(slip);
+  return true;
+}
+
+void SlipPrinter::printRumor(const Rumor &rumor) {
+  if (!rasterSlips_ || !printRumorBitmap(rumor)) {
+    printer_.boldOn();
+    printer_.println(rumor.textNl);
+    delay(10);
+    printer_.println(rumor.textEn);
+    delay(10);
+  }
+}
+
+void SlipPrinter::printSlipSeparator() {
+  printer_.feed(3);
+  delay(10);
+  printer_.println("- - - - - - - - - - - - - - - -");
+  delay(10);
+  printer_.feed(3);
+  delay(10);
+}
+
+void SlipPrinter::printRumors(const std::vector<Rumor> &batch) {
+  printer_.feed(2);
+  delay(10);
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (i > 0) {
+      printSlipSeparator();
+    }
+    printRumor(batch[i]);
+  }
+  printer_.feed(10);
+  delay(10);
+}
+
+void SlipPrinter::printNoRumors() {
+  printer_.boldOn();
+  printer_.feed(2);
+  delay(10);
+  printer_.println("No active rumors");
+  delay(10);
+  printer_.println("or max prints reached");
+  delay(10);
+  printer_.feed(6);
+  delay(10);
+}
@@ -0,0 +1,157 @@
+#include "trace.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+// A slot is valid while its seq matches the one the reader expects; writers
+// clear it first so a half-written slot never looks valid.
+struct TraceSlot {
+  std::atomic<uint32_t> seq{0};
+  uint32_t atUs = 0;
+  uint16_t job = 0;
+  uint8_t stage = 0;
+  uint8_t mill = 0;
+};
+
+TraceSlot slots[kTraceCapacity];
+std::atomic<uint32_t> nextSeq{1};
+std::atomic<uint32_t> nextJob{1};
+
+const char *const kStageNames[kTraceStageCount] = {
+    "reed_edge", "enqueued", "dequeued", "lock_acquired", "pick_done",
+    "first_byte", "printed", "saved", "job_done",
+};
+
+struct JobTimes {
+  uint16_t job;
+  uint16_t seen;
+  uint32_t atUs[kTraceStageCount];
+};
+
+// Nearest-rank percentile of an already sorted, non-empty list.
+uint32_t percentile(const std::vector<uint32_t> &sorted, uint32_t pct) {
+  size_t rank = (pct * sorted.size() + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+void summarize(std::vector<uint32_t> &samples, TraceSummary &out) {
+  out = TraceSummary();
+  if (samples.empty()) {
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  out.count = samples.size();
+  out.p50Us = percentile(samples, 50);
+  out.p90Us = percentile(samples, 90);
+  out.p99Us = percentile(samples, 99);
+  out.maxUs = samples.back();
+}
+
+}  // namespace
+
+const char *traceStageName(uint8_t stage) {
+  return stage < kTraceStageCount ? kStageNames[stage] : "unknown";
+}
+
+uint16_t traceNewJob() {
+  uint16_t job = static_cast<uint16_t>(nextJob.fetch_add(1, std::memory_order_relaxed));
+  // 0 never names a job.
+  return job ? job : traceNewJob();
+}
+
+void traceRecord(TraceStage stage, uint16_t job, uint8_t mill) {
+  traceRecordAt(stage, job, mill, esp_timer_get_time());
+}
+
+void traceRecordAt(TraceStage stage, uint16_t job, uint8_t mill, int64_t atUs) {
+  uint32_t seq = nextSeq.fetch_add(1, std::memory_order_relaxed);
+  TraceSlot &slot = slots[seq % kTraceCapacity];
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.atUs = static_cast<uint32_t>(atUs);
+  slot.job = job;
+  slot.stage = stage;
+  slot.mill = mill;
+  slot.seq.store(seq, std::memory_order_release);
+}
+
+size_t traceSnapshot(TraceEvent *out, size_t max) {
+  uint32_t end = nextSeq.load(std::memory_order_acquire);
+  uint32_t begin = end > kTraceCapacity ? end - kTraceCapacity : 1;
+  size_t count = 0;
+  for (uint32_t seq = begin; seq < end && count < max; ++seq) {
+    const TraceSlot &slot = slots[seq % kTraceCapacity];
+    if (slot.seq.load(std::memory_order_acquire) != seq) {
+      continue;
+    }
+    TraceEvent event;
+    event.seq = seq;
+    event.atUs = slot.atUs;
+    event.job = slot.job;
+    event.stage = slot.stage;
+    event.mill = slot.mill;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) {
+      // Overwritten while we copied it.
+      continue;
+    }
+    out[count++] = event;
+  }
+  return count;
+}
+
+void traceSummarize(const TraceEvent *events, size_t count, TraceSummary stages[kTraceStageCount],
+                    TraceSummary &total) {
+  std::vector<JobTimes> jobs;
+  for (size_t i = 0; i < count; ++i) {
+    const TraceEvent &event = events[i];
+    if (event.stage >= kTraceStageCount) {
+      continue;
+    }
+    JobTimes *times = nullptr;
+    for (auto &candidate : jobs) {
+      if (candidate.job == event.job) {
+        times = &candidate;
+        break;
+      }
+    }
+    if (!times) {
+      jobs.push_back(JobTimes{event.job, 0, {}});
+      times = &jobs.back();
+    }
+    // Retries repeat stages; the first attempt is the one a player waits on.
+    uint16_t bit = 1u << event.stage;
+    if (!(times->seen & bit)) {
+      times->seen |= bit;
+      times->atUs[event.stage] = event.atUs;
+    }
+  }
+
+  std::vector<uint32_t> samples[kTraceStageCount];
+  std::vector<uint32_t> totals;
+  for (const auto &times : jobs) {
+    int previous = -1;
+    for (int stage = 0; stage < kTraceStageCount; ++stage) {
+      if (!(times.seen & (1u << stage))) {
+        continue;
+      }
+      if (previous >= 0) {
+        samples[stage].push_back(times.atUs[stage] - times.atUs[previous]);
+      }
+      previous = stage;
+    }
+    const uint16_t ends = (1u << kTraceReedEdge) | (1u << kTraceJobDone);
+    if ((times.seen & ends) == ends) {
+      totals.push_back(times.atUs[kTraceJobDone] - times.atUs[kTraceReedEdge]);
+    }
+  }
+  for (int stage = 0; stage < kTraceStageCount; ++stage) {
+    summarize(samples[stage], stages[stage]);
+  }
+  summarize(totals, total);
+}
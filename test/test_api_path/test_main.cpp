@@ -0,0 +1,91 @@
+// Router path matching: literals, {id} segments and where a match has to
+// stop.
+//   pio test -e native
+
+#include <unity.h>
+
+#include "api_path.h"
+
+namespace {
+
+void test_literal_paths(void) {
+  ApiParams params;
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors", "/api/rumors", params));
+  TEST_ASSERT_EQUAL_UINT8(0, params.count);
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors", "/api/rumor", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors", "/api/Rumors", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors", "", params));
+}
+
+void test_number_segments(void) {
+  ApiParams params;
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors/{id}", "/api/rumors/7", params));
+  TEST_ASSERT_EQUAL_UINT8(1, params.count);
+  TEST_ASSERT_EQUAL_UINT32(7, params[0]);
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors/{id}/reset", "/api/rumors/0042/reset", params));
+  TEST_ASSERT_EQUAL_UINT32(42, params[0]);
+  TEST_ASSERT_TRUE(apiMatchPath("/api/mills/{mill}/rumors/{id}", "/api/mills/1/rumors/23", params));
+  TEST_ASSERT_EQUAL_UINT8(2, params.count);
+  TEST_ASSERT_EQUAL_UINT32(1, params[0]);
+  TEST_ASSERT_EQUAL_UINT32(23, params[1]);
+}
+
+void test_missing_digits(void) {
+  ApiParams params;
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/abc", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/-1", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/+1", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}/reset", "/api/rumors//reset", params));
+}
+
+void test_digit_overflow(void) {
+  ApiParams params;
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors/{id}", "/api/rumors/4294967295", params));
+  TEST_ASSERT_EQUAL_UINT32(4294967295u, params[0]);
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/4294967296", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/4294967300", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/99999999999999999999", params));
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors/{id}", "/api/rumors/0000000000004294967295", params));
+  TEST_ASSERT_EQUAL_UINT32(4294967295u, params[0]);
+}
+
+void test_trailing_segments(void) {
+  ApiParams params;
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors", "/api/rumors/7", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors", "/api/rumors/", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/7/reset", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/7/", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/7x", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}/reset", "/api/rumors/7", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}/reset", "/api/rumors/7/resetAll", params));
+  TEST_ASSERT_TRUE(apiMatchPath("/api/rumors/resetAll", "/api/rumors/resetAll", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id}", "/api/rumors/resetAll", params));
+}
+
+void test_param_limits(void) {
+  ApiParams params;
+  TEST_ASSERT_FALSE(apiMatchPath("/{a}/{b}/{c}", "/1/2/3", params));
+  TEST_ASSERT_FALSE(apiMatchPath("/api/rumors/{id", "/api/rumors/7", params));
+  // Every match counts its values afresh.
+  TEST_ASSERT_TRUE(apiMatchPath("/{a}/{b}", "/1/2", params));
+  TEST_ASSERT_TRUE(apiMatchPath("/api/status", "/api/status", params));
+  TEST_ASSERT_EQUAL_UINT8(0, params.count);
+}
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_literal_paths);
+  RUN_TEST(test_number_segments);
+  RUN_TEST(test_missing_digits);
+  RUN_TEST(test_digit_overflow);
+  RUN_TEST(test_trailing_segments);
+  RUN_TEST(test_param_limits);
+  return UNITY_END();
+}
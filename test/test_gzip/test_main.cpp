@@ -0,0 +1,394 @@
+// GzipWriter round trips, decoded by an independent inflater below (after
+// Mark Adler's puff.c, all three block types), with the CRC and length in
+// the trailer checked too.
+//   pio test -e native
+
+#include <unity.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "gzip.h"
+
+namespace {
+
+struct Huffman {
+  uint16_t count[16];
+  uint16_t symbol[320];
+};
+
+struct Inflater {
+  const std::vector<uint8_t> &in;
+  size_t pos;
+  uint32_t bitBuffer = 0;
+  int bitCount = 0;
+  bool failed = false;
+  std::vector<uint8_t> out;
+
+  Inflater(const std::vector<uint8_t> &input, size_t start) : in(input), pos(start) {}
+
+  int bits(int need) {
+    uint32_t value = bitBuffer;
+    while (bitCount < need) {
+      if (pos >= in.size()) {
+        failed = true;
+        return 0;
+      }
+      value |= static_cast<uint32_t>(in[pos++]) << bitCount;
+      bitCount += 8;
+    }
+    bitBuffer = value >> need;
+    bitCount -= need;
+    return static_cast<int>(value & ((1u << need) - 1));
+  }
+
+  int decode(const Huffman &h) {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; ++len) {
+      code |= bits(1);
+      int count = h.count[len];
+      if (code - count < first) {
+        return h.symbol[index + (code - first)];
+      }
+      index += count;
+      first += count;
+      first <<= 1;
+      code <<= 1;
+    }
+    failed = true;
+    return -1;
+  }
+
+  static void build(Huffman &h, const uint16_t *lengths, int n) {
+    memset(h.count, 0, sizeof(h.count));
+    for (int i = 0; i < n; ++i) {
+      h.count[lengths[i]]++;
+    }
+    uint16_t offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; ++len) {
+      offs[len + 1] = offs[len] + h.count[len];
+    }
+    for (int i = 0; i < n; ++i) {
+      if (lengths[i] != 0) {
+        h.symbol[offs[lengths[i]]++] = i;
+      }
+    }
+    h.count[0] = 0;
+  }
+
+  void stored() {
+    bitBuffer = 0;
+    bitCount = 0;
+    if (pos + 4 > in.size()) {
+      failed = true;
+      return;
+    }
+    unsigned len = in[pos] | (in[pos + 1] << 8);
+    unsigned nlen = in[pos + 2] | (in[pos + 3] << 8);
+    pos += 4;
+    if (len != (~nlen & 0xFFFF) || pos + len > in.size()) {
+      failed = true;
+      return;
+    }
+    out.insert(out.end(), in.begin() + pos, in.begin() + pos + len);
+    pos += len;
+  }
+
+  void codes(const Huffman &lencode, const Huffman &distcode) {
+    static const uint16_t lbase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                       31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint16_t lext[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t dbase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                       33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                       1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint16_t dext[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                      6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    for (;;) {
+      int symbol = decode(lencode);
+      if (failed) {
+        return;
+      }
+      if (symbol < 256) {
+        out.push_back(static_cast<uint8_t>(symbol));
+        continue;
+      }
+      if (symbol == 256) {
+        return;
+      }
+      symbol -= 257;
+      if (symbol >= 29) {
+        failed = true;
+        return;
+      }
+      size_t len = lbase[symbol] + bits(lext[symbol]);
+      int dsym = decode(distcode);
+      if (failed || dsym < 0 || dsym >= 30) {
+        failed = true;
+        return;
+      }
+      size_t dist = dbase[dsym] + bits(dext[dsym]);
+      if (dist > out.size()) {
+        failed = true;
+        return;
+      }
+      for (size_t i = 0; i < len; ++i) {
+        out.push_back(out[out.size() - dist]);
+      }
+    }
+  }
+
+  void fixed() {
+    uint16_t lengths[288];
+    int i = 0;
+    for (; i < 144; ++i) lengths[i] = 8;
+    for (; i < 256; ++i) lengths[i] = 9;
+    for (; i < 280; ++i) lengths[i] = 7;
+    for (; i < 288; ++i) lengths[i] = 8;
+    Huffman lencode, distcode;
+    build(lencode, lengths, 288);
+    for (i = 0; i < 30; ++i) lengths[i] = 5;
+    build(distcode, lengths, 30);
+    codes(lencode, distcode);
+  }
+
+  void dynamic() {
+    static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    int nlen = bits(5) + 257;
+    int ndist = bits(5) + 1;
+    int ncode = bits(4) + 4;
+    uint16_t lengths[320] = {};
+    for (int i = 0; i < ncode; ++i) {
+      lengths[order[i]] = bits(3);
+    }
+    Huffman lencode, distcode;
+    build(lencode, lengths, 19);
+    int index = 0;
+    while (!failed && index < nlen + ndist) {
+      int symbol = decode(lencode);
+      if (symbol < 16) {
+        lengths[index++] = symbol;
+        continue;
+      }
+      int len = 0, repeat;
+      if (symbol == 16) {
+        if (index == 0) {
+          failed = true;
+          return;
+        }
+        len = lengths[index - 1];
+        repeat = 3 + bits(2);
+      } else if (symbol == 17) {
+        repeat = 3 + bits(3);
+      } else {
+        repeat = 11 + bits(7);
+      }
+      if (index + repeat > nlen + ndist) {
+        failed = true;
+        return;
+      }
+      while (repeat--) {
+        lengths[index++] = len;
+      }
+    }
+    build(lencode, lengths, nlen);
+    build(distcode, lengths + nlen, ndist);
+    codes(lencode, distcode);
+  }
+
+  bool run() {
+    int last;
+    do {
+      last = bits(1);
+      int type = bits(2);
+      if (type == 0) {
+        stored();
+      } else if (type == 1) {
+        fixed();
+      } else if (type == 2) {
+        dynamic();
+      } else {
+        failed = true;
+      }
+    } while (!last && !failed);
+    return !failed;
+  }
+};
+
+uint32_t crc32(const std::vector<uint8_t> &data) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint8_t byte : data) {
+    crc ^= byte;
+    for (int k = 0; k < 8; ++k) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+uint32_t readLe32(const std::vector<uint8_t> &data, size_t at) {
+  return data[at] | (data[at + 1] << 8) | (data[at + 2] << 16) | (static_cast<uint32_t>(data[at + 3]) << 24);
+}
+
+// Compresses `input` in writes of `chunk` bytes and checks that it inflates
+// back to the same bytes with a matching trailer.
+void roundTrip(const std::vector<uint8_t> &input, size_t chunk) {
+  std::vector<uint8_t> gz;
+  GzipWriter *writer = new GzipWriter(gz);
+  for (size_t at = 0; at < input.size(); at += chunk) {
+    size_t n = input.size() - at < chunk ? input.size() - at : chunk;
+    writer->write(input.data() + at, n);
+  }
+  writer->finish();
+  delete writer;
+
+  TEST_ASSERT_TRUE(gz.size() >= 18);
+  TEST_ASSERT_EQUAL_HEX8(0x1F, gz[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x8B, gz[1]);
+  TEST_ASSERT_EQUAL_HEX8(8, gz[2]);
+  TEST_ASSERT_EQUAL_HEX8(0, gz[3]);
+
+  Inflater inflater(gz, 10);
+  TEST_ASSERT_TRUE_MESSAGE(inflater.run(), "invalid deflate stream");
+  TEST_ASSERT_EQUAL_UINT32(input.size(), inflater.out.size());
+  if (!input.empty()) {
+    TEST_ASSERT_EQUAL_MEMORY(input.data(), inflater.out.data(), input.size());
+  }
+  TEST_ASSERT_EQUAL_UINT32(inflater.pos + 8, gz.size());
+  TEST_ASSERT_EQUAL_HEX32(crc32(input), readLe32(gz, inflater.pos));
+  TEST_ASSERT_EQUAL_UINT32(input.size(), readLe32(gz, inflater.pos + 4));
+}
+
+void roundTripChunked(const std::vector<uint8_t> &input) {
+  static const size_t kChunks[] = {1, 7, 4095, 4096, 4097, 8192, 1 << 20};
+  for (size_t chunk : kChunks) {
+    roundTrip(input, chunk);
+  }
+}
+
+size_t compressedSize(const std::vector<uint8_t> &input) {
+  std::vector<uint8_t> gz;
+  GzipWriter *writer = new GzipWriter(gz);
+  writer->write(input.data(), input.size());
+  writer->finish();
+  delete writer;
+  return gz.size();
+}
+
+std::vector<uint8_t> bytesOf(const std::string &text) {
+  return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+// Deterministic pseudo-random bytes (xorshift).
+std::vector<uint8_t> noise(size_t size, uint32_t seed) {
+  std::vector<uint8_t> out(size);
+  for (auto &byte : out) {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    byte = static_cast<uint8_t>(seed);
+  }
+  return out;
+}
+
+// Rumor JSON much like the list the API sends.
+std::vector<uint8_t> rumorList(size_t count) {
+  std::string text = "[";
+  for (size_t i = 0; i < count; ++i) {
+    if (i > 0) {
+      text += ',';
+    }
+    text += "{\"id\":" + std::to_string(i + 1) + ",\"title\":\"Rumor number " + std::to_string(i * 7919 % 1000) +
+            "\",\"text_nl\":\"Er wordt gezegd dat de molen 's nachts draait.\",\"text_en\":\"They say the mill "
+            "turns at night.\",\"people\":\"Anna, Bram\",\"active\":true,\"max_prints\":3,\"printed_count\":" +
+            std::to_string(i % 4) + "}";
+  }
+  text += "]";
+  return bytesOf(text);
+}
+
+void test_empty(void) {
+  roundTrip(std::vector<uint8_t>(), 1);
+}
+
+void test_short_text(void) {
+  roundTripChunked(bytesOf("a"));
+  roundTripChunked(bytesOf("abcabcabcabcabcabc"));
+  roundTripChunked(bytesOf("{\"error\":\"busy\"}"));
+}
+
+void test_runs_and_max_match(void) {
+  roundTripChunked(std::vector<uint8_t>(1000, 'x'));
+  // Matches capped at 258 with a remainder of every length below it.
+  for (size_t len = 256; len <= 262; ++len) {
+    roundTrip(std::vector<uint8_t>(len * 3, 'y'), 1 << 20);
+  }
+}
+
+void test_incompressible(void) {
+  roundTripChunked(noise(20000, 1));
+}
+
+// Several times the 4 KB window, so the buffer slides and matches reach
+// back across the slide.
+void test_window_wrap(void) {
+  roundTripChunked(rumorList(200));
+  std::vector<uint8_t> input = noise(4096, 2);
+  std::vector<uint8_t> again = input;
+  input.insert(input.end(), again.begin(), again.end());
+  input.insert(input.end(), again.begin(), again.end());
+  roundTripChunked(input);
+}
+
+// Positions are kept as 16-bit stream offsets. A block that repeats every
+// 64 KB makes stale entries alias to current positions exactly, so any
+// entry that is not checked against the distance shows up as a bad match.
+void test_position_aliasing(void) {
+  std::vector<uint8_t> block = noise(65536, 3);
+  std::vector<uint8_t> input;
+  for (int i = 0; i < 3; ++i) {
+    input.insert(input.end(), block.begin(), block.end());
+  }
+  roundTrip(input, 1 << 20);
+  roundTrip(input, 4097);
+
+  // A trigram seen once and then again exactly 64 KB later: its hash entry
+  // is still there and aliases the current position (distance 0).
+  std::string text = "abc";
+  text.append(65533, 'z');
+  text += "abcdef";
+  text.append(65530, 'z');
+  text += "abcdef";
+  roundTripChunked(bytesOf(text));
+
+  std::vector<uint8_t> list = rumorList(1500);
+  TEST_ASSERT_TRUE(list.size() > 3 * 65536);
+  roundTripChunked(list);
+  // Past 64 KB matches must still be found, not dropped as stale.
+  TEST_ASSERT_TRUE(compressedSize(list) * 2 < list.size());
+}
+
+void test_compresses_json(void) {
+  std::vector<uint8_t> input = rumorList(200);
+  TEST_ASSERT_TRUE(compressedSize(input) * 2 < input.size());
+}
+
+}  // namespace
+
+void setUp(void) {}
+void tearDown(void) {}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_short_text);
+  RUN_TEST(test_runs_and_max_match);
+  RUN_TEST(test_incompressible);
+  RUN_TEST(test_window_wrap);
+  RUN_TEST(test_position_aliasing);
+  RUN_TEST(test_compresses_json);
+  return UNITY_END();
+}